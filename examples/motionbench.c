@@ -0,0 +1,183 @@
+/**
+ * rutabaga: an OpenGL widget toolkit
+ * Copyright (c) 2013 William Light.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * motionbench: fills a window with a single container holding a grid of
+ * buttons, then feeds it a stream of synthetic pointer motion events (a
+ * deterministic random walk across the window) and reports the average
+ * time spent handling each one.
+ *
+ * run it with a few different element counts to see how the cost of
+ * hit-testing scales with the number of siblings.
+ *
+ *     usage: motionbench [elements] [events]
+ */
+
+#include <assert.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "rutabaga/rutabaga.h"
+#include "rutabaga/container.h"
+#include "rutabaga/window.h"
+#include "rutabaga/platform.h"
+#include "rutabaga/layout.h"
+
+#include "rutabaga/widgets/button.h"
+
+#define MAX_STEP 8
+
+static void
+grid_layout(struct rtb_element *elem)
+{
+	struct rtb_element *iter;
+	struct rtb_point position;
+	struct rtb_size cell;
+	int n, cols, i;
+
+	n = 0;
+	TAILQ_FOREACH(iter, &elem->children, child)
+		n++;
+
+	if (!n)
+		return;
+
+	cols = (int) ceilf(sqrtf(n * (elem->w / elem->h)));
+	cell.w = elem->w / cols;
+	cell.h = elem->h / ceilf(n / (float) cols);
+
+	i = 0;
+	TAILQ_FOREACH(iter, &elem->children, child) {
+		position.x = elem->x + ((i % cols) * cell.w);
+		position.y = elem->y + ((i / cols) * cell.h);
+
+		rtb_elem_set_position_from_point(iter, &position);
+		rtb_elem_set_size(iter, &cell);
+		i++;
+	}
+}
+
+static rtb_container_t *
+setup_ui(struct rtb_window *win, int count)
+{
+	rtb_container_t *grid;
+	int i;
+
+	grid = rtb_container_new();
+	rtb_elem_set_size_cb(grid, rtb_size_fill);
+	rtb_elem_set_layout(grid, grid_layout);
+
+	grid->outer_pad.x = grid->outer_pad.y = 0.f;
+	grid->inner_pad.x = grid->inner_pad.y = 0.f;
+
+	/* fill the container before it's attached, so that we don't reflow
+	 * the whole thing once per child. */
+	for (i = 0; i < count; i++)
+		rtb_container_add(grid, RTB_ELEMENT(rtb_button_new(NULL)));
+
+	rtb_elem_add_child(RTB_ELEMENT(win), grid, RTB_ADD_TAIL);
+	return grid;
+}
+
+static int
+step(int pos, int min, int max, unsigned int *seed)
+{
+	pos += (int) (rand_r(seed) % ((MAX_STEP * 2) + 1)) - MAX_STEP;
+
+	if (pos < min)
+		return min;
+	if (pos > max)
+		return max;
+	return pos;
+}
+
+static void
+run(struct rtb_window *win, rtb_container_t *grid, int events)
+{
+	unsigned int seed = 1;
+	uint64_t start, elapsed;
+	int i, x, y, x1, y1, x2, y2;
+
+	/* keep the walk inside the grid. wandering out of it would restyle
+	 * every child on each crossing, and that's not what we're measuring. */
+	x1 = (int) ceilf(grid->x);
+	y1 = (int) ceilf(grid->y);
+	x2 = (int) grid->x2;
+	y2 = (int) grid->y2;
+
+	x = (x1 + x2) / 2;
+	y = (y1 + y2) / 2;
+
+	/* the first motion event only enters the window, and the first
+	 * hit-test builds the index. keep both out of the measurement. */
+	rtb__platform_mouse_motion(win, x, y);
+	rtb__platform_mouse_motion(win, x, y);
+
+	start = uv_hrtime();
+
+	for (i = 0; i < events; i++) {
+		x = step(x, x1, x2, &seed);
+		y = step(y, y1, y2, &seed);
+
+		rtb__platform_mouse_motion(win, x, y);
+	}
+
+	elapsed = uv_hrtime() - start;
+
+	printf("  %8.1f ns/event\n", elapsed / (double) events);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct rutabaga *delicious;
+	struct rtb_window *win;
+	rtb_container_t *grid;
+	int count, events;
+
+	count  = (argc > 1) ? atoi(argv[1]) : 4000;
+	events = (argc > 2) ? atoi(argv[2]) : 1000000;
+
+	delicious = rtb_new();
+	assert(delicious);
+	win = rtb_window_open(delicious, 1280, 800, "motionbench");
+	assert(win);
+
+	rtb_window_lock(win);
+
+	grid = setup_ui(win, count);
+	rtb_window_reinit(win);
+
+	printf("%d elements, %d events\n", count, events);
+	run(win, grid, events);
+
+	rtb_window_close(win);
+	rtb_free(delicious);
+
+	return 0;
+}
@@ -0,0 +1,216 @@
+/**
+ * rutabaga: an OpenGL widget toolkit
+ * Copyright (c) 2013 William Light.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * paramtable: a few thousand rows of label + knob + spinbox in a
+ * virtual list. only enough rows to fill the window ever exist, and
+ * they get handed new parameters to show as the list scrolls. passing a
+ * non-zero second argument draws the text from signed distance fields
+ * instead of bitmap glyphs.
+ *
+ *     usage: paramtable [parameters] [distance fields]
+ */
+
+#include <assert.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "rutabaga/rutabaga.h"
+#include "rutabaga/window.h"
+#include "rutabaga/font-manager.h"
+#include "rutabaga/layout.h"
+#include "rutabaga/event.h"
+
+#include "rutabaga/widgets/label.h"
+#include "rutabaga/widgets/knob.h"
+#include "rutabaga/widgets/spinbox.h"
+#include "rutabaga/widgets/virtual-list.h"
+
+struct param_table {
+	float *values;
+	int count;
+};
+
+struct param_row {
+	struct rtb_element elem;
+
+	struct rtb_label name;
+	struct rtb_knob knob;
+	struct rtb_spinbox spinbox;
+
+	struct param_table *table;
+	int index;
+};
+
+static int
+value_changed(struct rtb_element *elem, const struct rtb_event *_e,
+		void *ctx)
+{
+	const struct rtb_value_event *e = RTB_EVENT_AS(_e, rtb_value_event);
+	struct param_row *row = ctx;
+
+	/* ours, from bind_row() or from the other control just below. */
+	if (e->source == RTB_EVENT_SYNTHETIC)
+		return 0;
+
+	row->table->values[row->index] = e->value;
+
+	/* keep the other control showing the same thing. */
+	if (elem == RTB_ELEMENT(&row->knob))
+		rtb_value_element_set_value(RTB_VALUE_ELEMENT(&row->spinbox),
+				e->value);
+	else
+		rtb_value_element_set_value(RTB_VALUE_ELEMENT(&row->knob),
+				e->value);
+
+	return 1;
+}
+
+/**
+ * list source
+ */
+
+static struct rtb_element *
+create_row(struct rtb_virtual_list *list, void *ctx)
+{
+	struct param_row *row = calloc(1, sizeof(*row));
+
+	rtb_elem_init(&row->elem);
+	rtb_elem_set_layout(&row->elem, rtb_layout_hpack_left);
+
+	rtb_label_init(&row->name);
+	rtb_knob_init(&row->knob);
+	rtb_spinbox_init(&row->spinbox);
+
+	row->name.align = RTB_ALIGN_MIDDLE;
+	row->name.min_size.w = 120.f;
+	row->knob.align = RTB_ALIGN_MIDDLE;
+	row->spinbox.align = RTB_ALIGN_MIDDLE;
+
+	rtb_elem_add_child(&row->elem, RTB_ELEMENT(&row->name), RTB_ADD_TAIL);
+	rtb_elem_add_child(&row->elem, RTB_ELEMENT(&row->knob), RTB_ADD_TAIL);
+	rtb_elem_add_child(&row->elem, RTB_ELEMENT(&row->spinbox),
+			RTB_ADD_TAIL);
+
+	row->table = ctx;
+
+	rtb_register_handler(RTB_ELEMENT(&row->knob),
+			RTB_VALUE_CHANGE, value_changed, row);
+	rtb_register_handler(RTB_ELEMENT(&row->spinbox),
+			RTB_VALUE_CHANGE, value_changed, row);
+
+	return &row->elem;
+}
+
+static void
+bind_row(struct rtb_virtual_list *list, struct rtb_element *elem,
+		int index, void *ctx)
+{
+	struct param_row *row = (struct param_row *) elem;
+	char name[32];
+
+	/* set this first, since setting the values below will come back
+	 * through value_changed(). */
+	row->index = index;
+
+	snprintf(name, sizeof(name), "parameter %d", index + 1);
+	rtb_label_set_text(&row->name, name);
+
+	rtb_value_element_set_value(RTB_VALUE_ELEMENT(&row->knob),
+			row->table->values[index]);
+	rtb_value_element_set_value(RTB_VALUE_ELEMENT(&row->spinbox),
+			row->table->values[index]);
+}
+
+static void
+destroy_row(struct rtb_virtual_list *list, struct rtb_element *elem,
+		void *ctx)
+{
+	struct param_row *row = (struct param_row *) elem;
+
+	rtb_spinbox_fini(&row->spinbox);
+	rtb_knob_fini(&row->knob);
+	rtb_label_fini(&row->name);
+	rtb_elem_fini(&row->elem);
+
+	free(row);
+}
+
+static const struct rtb_virtual_list_source param_source = {
+	.create  = create_row,
+	.bind    = bind_row,
+	.destroy = destroy_row
+};
+
+int
+main(int argc, char **argv)
+{
+	struct rtb_virtual_list *list;
+	struct param_table table;
+	struct rutabaga *delicious;
+	struct rtb_window *win;
+	int i, distance_fields;
+
+	table.count     = (argc > 1) ? atoi(argv[1]) : 5000;
+	distance_fields = (argc > 2) ? atoi(argv[2]) : 0;
+	table.values = calloc(table.count, sizeof(*table.values));
+	assert(table.values);
+
+	for (i = 0; i < table.count; i++)
+		table.values[i] = (i % 100) / 100.f;
+
+	delicious = rtb_new();
+	assert(delicious);
+	win = rtb_window_open(delicious, 400, 600, "paramtable");
+	assert(win);
+
+	/* the stylesheet's fonts aren't loaded until the event loop calls
+	 * rtb_window_reinit(), so this still catches them. */
+	rtb_font_manager_use_distance_fields(&win->font_manager,
+			distance_fields);
+
+	rtb_elem_set_layout(RTB_ELEMENT(win), rtb_layout_vpack_top);
+
+	list = rtb_virtual_list_new();
+	assert(list);
+
+	rtb_virtual_list_set_item_height(list, 50.f);
+	rtb_virtual_list_set_source(list, &param_source, &table);
+	rtb_virtual_list_set_count(list, table.count);
+
+	rtb_elem_add_child(RTB_ELEMENT(win), RTB_ELEMENT(list), RTB_ADD_TAIL);
+
+	rtb_event_loop(delicious);
+
+	rtb_window_lock(win);
+	rtb_virtual_list_free(list);
+	rtb_window_close(win);
+	rtb_free(delicious);
+
+	free(table.values);
+	return 0;
+}
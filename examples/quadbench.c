@@ -0,0 +1,138 @@
+/**
+ * rutabaga: an OpenGL widget toolkit
+ * Copyright (c) 2013 William Light.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * quadbench: draws a window full of stylequads (knobs, buttons and their
+ * containers) from scratch a number of times, first with batching turned
+ * off and then with it on, and reports the average frame time and number
+ * of draw calls for each.
+ *
+ *     usage: quadbench [elements] [frames]
+ */
+
+#include <assert.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "rutabaga/rutabaga.h"
+#include "rutabaga/container.h"
+#include "rutabaga/window.h"
+#include "rutabaga/surface.h"
+#include "rutabaga/layout.h"
+
+#include "rutabaga/widgets/button.h"
+#include "rutabaga/widgets/knob.h"
+
+#define PER_ROW 40
+
+static void
+setup_ui(struct rtb_window *win, int count)
+{
+	rtb_container_t *row = NULL;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (!(i % PER_ROW)) {
+			row = rtb_container_new();
+
+			rtb_elem_set_size_cb(row, rtb_size_hfill);
+			rtb_elem_set_layout(row, rtb_layout_hpack_left);
+			rtb_elem_add_child(RTB_ELEMENT(win), row, RTB_ADD_TAIL);
+		}
+
+		if (i % 2)
+			rtb_container_add(row, RTB_ELEMENT(rtb_knob_new()));
+		else
+			rtb_container_add(row, RTB_ELEMENT(rtb_button_new(NULL)));
+	}
+}
+
+static void
+run(struct rtb_window *win, int batching, int frames)
+{
+	struct rtb_render_context *ctx = &RTB_SURFACE(win)->render_ctx;
+	unsigned int draw_calls;
+	uint64_t start, elapsed;
+	int i;
+
+	ctx->batching = batching;
+
+	/* warm up, so that any one-off costs (shader compilation in the
+	 * driver, style loading) don't land in the measurement. */
+	rtb_surface_invalidate(RTB_SURFACE(win));
+	rtb_window_draw(win, 0);
+	glFinish();
+
+	draw_calls = 0;
+	elapsed = 0;
+
+	for (i = 0; i < frames; i++) {
+		rtb_surface_invalidate(RTB_SURFACE(win));
+
+		start = uv_hrtime();
+		rtb_window_draw(win, 0);
+		glFinish();
+		elapsed += uv_hrtime() - start;
+
+		draw_calls += rtb_window_get_frame_stats(win)->draw_calls;
+	}
+
+	printf("  batching %-3s  %8.3f ms/frame  %8.1f draw calls/frame\n",
+			batching ? "on" : "off",
+			(elapsed / (double) frames) / 1e+06,
+			draw_calls / (double) frames);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct rutabaga *delicious;
+	struct rtb_window *win;
+	int count, frames;
+
+	count  = (argc > 1) ? atoi(argv[1]) : 2000;
+	frames = (argc > 2) ? atoi(argv[2]) : 200;
+
+	delicious = rtb_new();
+	assert(delicious);
+	win = rtb_window_open(delicious, 1280, 800, "quadbench");
+	assert(win);
+
+	rtb_window_lock(win);
+
+	setup_ui(win, count);
+	rtb_window_reinit(win);
+
+	printf("%d elements, %d frames\n", count, frames);
+	run(win, 0, frames);
+	run(win, 1, frames);
+
+	rtb_window_close(win);
+	rtb_free(delicious);
+
+	return 0;
+}
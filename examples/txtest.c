@@ -24,51 +24,190 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+/**
+ * txtest: measures how quickly text gets turned into glyphs. it looks up
+ * every glyph in a set straight from the font's cache, then lays out
+ * labels made from the same set with rtb_text_object_update(), and
+ * reports glyphs per second for each. it does this for plain ASCII and
+ * for a "wide" set of CJK ideographs and symbols, which is what makes
+ * the font's glyph cache grow into the thousands.
+ *
+ *     usage: txtest [wide glyphs] [iterations]
+ */
+
 #include <assert.h>
 
-#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
 
 #include "rutabaga/rutabaga.h"
 #include "rutabaga/window.h"
-#include "rutabaga/layout.h"
+#include "rutabaga/text-object.h"
+
+#include "rutabaga/widgets/label.h"
+
+#define LABEL_LENGTH 64
 
-#include "rutabaga/widgets/button.h"
+/* where the wide set is drawn from, taken in turn. */
+static const rtb_utf32_t ranges[][2] = {
+	{0x4E00, 0x9FFF}, /* CJK unified ideographs */
+	{0x2190, 0x21FF}, /* arrows */
+	{0x2200, 0x22FF}, /* mathematical operators */
+	{0x25A0, 0x25FF}, /* geometric shapes */
+	{0x3040, 0x30FF}  /* hiragana and katakana */
+};
 
 #define ARRAY_LENGTH(a) (sizeof(a) / sizeof(*a))
 
-int main(int argc, char **argv)
+static rtb_utf32_t *
+make_set(int count, int wide)
+{
+	rtb_utf32_t *set = calloc(count + 1, sizeof(*set));
+	int i, range, offset;
+
+	assert(set);
+
+	for (i = 0; i < count; i++) {
+		if (!wide) {
+			set[i] = ' ' + 1 + (i % ('~' - ' '));
+			continue;
+		}
+
+		range  = i % ARRAY_LENGTH(ranges);
+		offset = i / ARRAY_LENGTH(ranges);
+
+		set[i] = ranges[range][0]
+			+ (offset % (ranges[range][1] - ranges[range][0] + 1));
+	}
+
+	return set;
+}
+
+static int
+utf8_encode(char *out, rtb_utf32_t c)
+{
+	if (c < 0x80) {
+		out[0] = c;
+		return 1;
+	} else if (c < 0x800) {
+		out[0] = 0xC0 | (c >> 6);
+		out[1] = 0x80 | (c & 0x3F);
+		return 2;
+	} else if (c < 0x10000) {
+		out[0] = 0xE0 | (c >> 12);
+		out[1] = 0x80 | ((c >> 6) & 0x3F);
+		out[2] = 0x80 | (c & 0x3F);
+		return 3;
+	}
+
+	out[0] = 0xF0 | (c >> 18);
+	out[1] = 0x80 | ((c >> 12) & 0x3F);
+	out[2] = 0x80 | ((c >> 6) & 0x3F);
+	out[3] = 0x80 | (c & 0x3F);
+	return 4;
+}
+
+/* every label is LABEL_LENGTH characters long, starting at a different
+ * place in the set each time so that they don't all hit the same glyphs. */
+static char *
+make_label(const rtb_utf32_t *set, int count, int n)
+{
+	char *label = malloc(LABEL_LENGTH * 4 + 1);
+	int i, len = 0;
+
+	assert(label);
+
+	for (i = 0; i < LABEL_LENGTH; i++)
+		len += utf8_encode(label + len, set[(n * 7 + i * 13) % count]);
+
+	label[len] = '\0';
+	return label;
+}
+
+static void
+report(const char *what, uint64_t glyphs, uint64_t elapsed)
+{
+	printf("  %-20s %12.0f glyphs/s  (%8.1f ns/glyph)\n", what,
+			glyphs / (elapsed / 1e+09), elapsed / (double) glyphs);
+}
+
+static void
+run(struct rtb_font *font, struct rtb_text_object *tobj,
+		const char *name, int count, int wide, int iterations)
+{
+	rtb_utf32_t *set = make_set(count, wide);
+	texture_font_t *txfont = font->txfont;
+	char *labels[16];
+	uint64_t start, elapsed;
+	int i, j, missing;
+
+	/* load the whole set in one go, so that it doesn't count towards the
+	 * lookups below. */
+	start = uv_hrtime();
+	missing = texture_font_load_glyphs(txfont, set);
+	elapsed = uv_hrtime() - start;
+
+	printf("%s: %d glyphs (%d didn't fit), loaded in %.1f ms, "
+			"%zu in the font, %zux%zu atlas\n", name, count, missing,
+			elapsed / 1e+06, vector_size(txfont->glyphs),
+			txfont->atlas->width, txfont->atlas->height);
+
+	start = uv_hrtime();
+	for (i = 0; i < iterations; i++)
+		for (j = 0; j < count; j++)
+			texture_font_get_glyph(txfont, set[j]);
+	elapsed = uv_hrtime() - start;
+
+	report("glyph lookup", (uint64_t) iterations * count, elapsed);
+
+	for (i = 0; i < (int) ARRAY_LENGTH(labels); i++)
+		labels[i] = make_label(set, count, i);
+
+	start = uv_hrtime();
+	for (i = 0; i < iterations; i++)
+		for (j = 0; j < (int) ARRAY_LENGTH(labels); j++)
+			rtb_text_object_update(tobj, font, labels[j]);
+	elapsed = uv_hrtime() - start;
+
+	report("text object update",
+			(uint64_t) iterations * ARRAY_LENGTH(labels) * LABEL_LENGTH,
+			elapsed);
+
+	for (i = 0; i < (int) ARRAY_LENGTH(labels); i++)
+		free(labels[i]);
+
+	free(set);
+}
+
+int
+main(int argc, char **argv)
 {
 	struct rutabaga *delicious;
 	struct rtb_window *win;
-	struct rtb_button butt;
+	struct rtb_label *label;
+	int count, iterations;
+
+	count      = (argc > 1) ? atoi(argv[1]) : 1500;
+	iterations = (argc > 2) ? atoi(argv[2]) : 200;
 
 	delicious = rtb_new();
 	assert(delicious);
-	win = rtb_window_open(delicious, 450, 600, "texture test");
+	win = rtb_window_open(delicious, 450, 600, "txtest");
 	assert(win);
 
-	win->outer_pad.x = 0.f;
-	win->outer_pad.y = 0.f;
-
-	rtb_elem_set_layout(RTB_ELEMENT(win), rtb_layout_vpack_middle);
-
-	rtb_button_init(&butt);
-
-	butt.align = RTB_ALIGN_CENTER;
-	butt.min_size.w = 250;
-	butt.min_size.h = 100;
+	rtb_window_lock(win);
 
-	rtb_button_set_label(&butt, "my texture game krispy");
-	rtb_elem_set_size_cb(RTB_ELEMENT(&butt), rtb_size_fill);
-	rtb_elem_add_child(RTB_ELEMENT(win), RTB_ELEMENT(&butt),
-			RTB_ADD_HEAD);
+	/* the label is only here to get the default font out of the style. */
+	label = rtb_label_new("txtest");
+	rtb_elem_add_child(RTB_ELEMENT(win), RTB_ELEMENT(label), RTB_ADD_TAIL);
+	rtb_window_reinit(win);
+	assert(label->font);
 
-	rtb_event_loop(delicious);
+	run(label->font, label->tobj, "ascii", '~' - ' ', 0, iterations);
+	run(label->font, label->tobj, "wide", count, 1, iterations);
 
-	rtb_window_lock(win);
 	rtb_window_close(win);
 	rtb_free(delicious);
+
+	return 0;
 }
@@ -64,7 +64,9 @@ typedef enum {
 
 	RTB_STATE_FOCUS,
 	RTB_STATE_FOCUS_HOVER,
-	RTB_STATE_FOCUS_ACTIVE
+	RTB_STATE_FOCUS_ACTIVE,
+
+	RTB_ELEM_STATE_COUNT
 } rtb_elem_state_t;
 
 /**
@@ -119,6 +121,8 @@ struct rtb_element_implementation {
 	 * rtb_element_implementation.size_cb
 	 *
 	 * called when the element should report its desired size.
+	 * layout code should go through rtb_elem_measure() rather than
+	 * calling this directly, so that the result gets cached.
 	 */
 	rtb_elem_cb_size_t size_cb;
 
@@ -201,6 +205,18 @@ struct rtb_element_implementation {
 	rtb_elem_cb_t mark_dirty;
 };
 
+/* a size_cb result, along with everything it was computed from other
+ * than the element's children (whose changes clear the whole cache). */
+struct rtb_measurement {
+	struct rtb_size avail;
+	struct rtb_size size;
+	struct rtb_size min_size;
+
+	struct rtb_size want;
+};
+
+#define RTB_MEASURE_CACHE_SIZE 2
+
 struct rtb_element_event {
 	RTB_INHERIT(rtb_event);
 	struct rtb_element *element;
@@ -234,9 +250,14 @@ struct rtb_element {
 	struct rtb_rect inner_rect;
 	struct rtb_stylequad stylequad;
 
-	/* assign these via the stylesheet */
+	/* assign these via the stylesheet. a `max_size` of 0 means no
+	 * maximum. the flex_* factors are only looked at by the flex
+	 * layouts, which also take a parent's `inner_pad` as the gap
+	 * between its children. */
 	struct rtb_size min_size;
 	struct rtb_size max_size;
+	float flex_grow;
+	float flex_shrink;
 
 	int mouse_in;
 
@@ -244,7 +265,45 @@ struct rtb_element {
 	struct rtb_window  *window;
 	struct rtb_surface *surface;
 
+	/* the outermost ancestor below `surface` that has a background,
+	 * or NULL if there isn't one. kept up to date on attach, detach and
+	 * restyle so that rtb_elem_nearest_clearable() doesn't have to walk
+	 * the tree. */
+	struct rtb_element *opaque_ancestor;
+
+	/* the resolved style block that was last loaded into this element,
+	 * which reload_style() diffs against the one for the current state. */
+	const struct rtb_resolved_style *resolved_style;
+
+	/* layout bookkeeping. `need_measure` throws away the measure cache
+	 * before the next rtb_elem_measure(). `need_layout` makes the next
+	 * leafward reflow include this element even if its rect hasn't
+	 * changed since `laid_out`, which is where it was last reflowed.
+	 * both get set on an element and all of its ancestors when its size
+	 * or its children change. */
+	int need_measure;
+	int need_layout;
+	struct rtb_rect laid_out;
+
+	/* set when restyle() skipped this element for being off-screen. */
+	int need_restyle;
+
+	struct {
+		struct rtb_measurement entries[RTB_MEASURE_CACHE_SIZE];
+		int count;
+		int next;
+	} measure_cache;
+
+	/* spatial index over `children` for mouse hit-testing, built on
+	 * demand by rtb_child_grid_hit() and thrown away on reflow. */
+	struct rtb_child_grid *child_grid;
+
+	/* sorted by event type, and in the order they were added within a
+	 * type. `handler_mask` has a bit set for each type that has a
+	 * handler (see src/event.c), so that events nobody here is
+	 * listening for can be passed over without looking at the list. */
 	VECTOR(handlers, struct rtb_event_handler) handlers;
+	uint64_t handler_mask;
 	TAILQ_ENTRY(rtb_element) child;
 	TAILQ_ENTRY(rtb_element) render_entry;
 };
@@ -269,11 +328,54 @@ int rtb_elem_is_clearable(struct rtb_element *);
 struct rtb_element *rtb_elem_nearest_clearable(struct rtb_element *);
 
 void rtb_elem_mark_dirty(struct rtb_element *);
+
+/**
+ * returns 1 if an element between this one and its surface is in the
+ * surface's render queue, in which case redrawing that will redraw this
+ * one too.
+ */
+int rtb_elem_has_queued_ancestor(struct rtb_element *);
+
 void rtb_elem_trigger_reflow(struct rtb_element *,
 		struct rtb_element *instigator, rtb_ev_direction_t direction);
 void rtb_elem_reflow_leafward(struct rtb_element *);
 void rtb_elem_reflow_rootward(struct rtb_element *);
 
+/**
+ * the above reflow immediately. rtb_elem_request_reflow() instead marks
+ * the element as wanting a different size (or as needing its children
+ * laid out again) and leaves the work for the layout pass that
+ * rtb_window_draw() does before drawing, so that any number of changes
+ * between two frames cost one pass.
+ *
+ * rtb_elem_request_layout() is the same, but for when only the
+ * element's children need moving (scrolling, say) and its own size
+ * isn't going to change.
+ *
+ * rtb_elem_flush_layout() runs that pass now, for code that needs
+ * up-to-date geometry before the next frame.
+ */
+void rtb_elem_request_reflow(struct rtb_element *);
+void rtb_elem_request_layout(struct rtb_element *);
+void rtb_elem_flush_layout(struct rtb_element *);
+
+/**
+ * `visibility` is worked out during reflow, from where an element is
+ * against the surface it's drawn into (and the surfaces that one is in,
+ * and so on). elements that are RTB_FULLY_OBSCURED aren't drawn,
+ * hit-tested or restyled. this recomputes it for a whole subtree, for
+ * when a surface changes size without its children moving.
+ */
+void rtb_elem_update_visibility(struct rtb_element *);
+
+/**
+ * asks the element how big it wants to be given `avail`, via its
+ * size_cb, or returns the answer from last time if nothing it depends
+ * on has changed since.
+ */
+void rtb_elem_measure(struct rtb_element *,
+		const struct rtb_size *avail, struct rtb_size *want);
+
 void rtb_elem_set_size_cb(struct rtb_element *, rtb_elem_cb_size_t size_cb);
 void rtb_elem_set_layout(struct rtb_element *, rtb_elem_cb_t layout_cb);
 void rtb_elem_set_position_from_point(struct rtb_element *, struct rtb_point *);
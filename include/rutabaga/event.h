@@ -132,11 +132,26 @@ struct rtb_element *rtb_dispatch_raw(struct rtb_element *target,
 struct rtb_element *rtb_dispatch_simple(struct rtb_element *target,
 		rtb_ev_type_t type);
 
+/**
+ * an element can have any number of handlers for each event type.
+ * rtb_handle() calls all of them, in the order they were added.
+ *
+ * rtb_register_handler() replaces every handler `on_elem` has for
+ * `for_type` with the one given, and rtb_unregister_handler() removes
+ * them all. rtb_add_handler() and rtb_remove_handler() add or remove
+ * just one, leaving any others in place.
+ */
+
 int rtb_register_handler(struct rtb_element *on_elem,
 		rtb_ev_type_t for_type, rtb_event_cb_t handler, void *context);
 void rtb_unregister_handler(struct rtb_element *on_elem,
 		rtb_ev_type_t for_type);
 
+int rtb_add_handler(struct rtb_element *on_elem,
+		rtb_ev_type_t for_type, rtb_event_cb_t handler, void *context);
+void rtb_remove_handler(struct rtb_element *on_elem,
+		rtb_ev_type_t for_type, rtb_event_cb_t handler, void *context);
+
 void rtb_event_loop_init(struct rutabaga *);
 void rtb_event_loop_run(struct rutabaga *);
 void rtb_event_loop_fini(struct rutabaga *);
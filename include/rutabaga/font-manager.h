@@ -26,11 +26,19 @@
 
 #pragma once
 
+#include <uv.h>
+
 #include "rutabaga/shader.h"
 
 #include "freetype-gl/freetype-gl.h"
 #include "freetype-gl/vertex-buffer.h"
 
+#define RTB_TEXT_RUN_BUCKETS 256
+
+struct rtb_text_run;
+struct rtb_distance_field_face;
+struct rtb_glyph_prewarm;
+
 #define RTB_FONT(x) RTB_UPCAST(x, rtb_font)
 #define RTB_FONT_AS(x, type) RTB_DOWNCAST(x, type, rtb_font)
 
@@ -38,6 +46,11 @@ struct rtb_font {
 	int size;
 	float lcd_gamma;
 
+	/* distance field fonts share one `txfont` between every size of a
+	 * face, and are laid out at `scale` times its size. */
+	int distance_field;
+	float scale;
+
 	texture_font_t *txfont;
 	struct rtb_font_manager *fm;
 };
@@ -53,9 +66,41 @@ struct rtb_font_manager {
 
 		GLint atlas_pixel;
 		GLint gamma;
+
+		GLint subpixel_shift;
+		GLint vertex_color;
 	} shader;
 
 	texture_atlas_t *atlas;
+
+	/* fonts loaded while `enabled` is set are rasterised once per face as
+	 * signed distance fields, and scaled to size when drawn. */
+	struct {
+		int enabled;
+
+		struct rtb_font_shader shader;
+		texture_atlas_t *atlas;
+		struct rtb_distance_field_face *faces;
+	} distance_field;
+
+	/* hash table of text runs, keyed on font and text. */
+	struct rtb_text_run *runs[RTB_TEXT_RUN_BUCKETS];
+
+	/* newly loaded fonts have their default glyphs rasterised on a worker
+	 * thread, which only ever reads the font. `lock` covers the lists
+	 * and `job`, the one the thread is on. */
+	struct {
+		uv_mutex_t lock;
+		uv_cond_t job_done;
+		uv_thread_t thread;
+
+		int thread_started;
+		int thread_exiting;
+
+		struct rtb_glyph_prewarm *queue;
+		struct rtb_glyph_prewarm *job;
+		struct rtb_glyph_prewarm *done;
+	} prewarm;
 };
 
 int rtb_font_manager_load_embedded_font(struct rtb_font_manager *fm,
@@ -66,5 +111,23 @@ int rtb_font_manager_load_external_font(struct rtb_font_manager *fm,
 		struct rtb_external_font *font, int pt_size, const char *path);
 void rtb_font_manager_free_external_font(struct rtb_external_font *font);
 
+/**
+ * fonts loaded after this is called with a non-zero `enable` are drawn from
+ * signed distance fields. every size of a face then shares one set of
+ * glyphs, at the cost of the hinting and LCD subpixel rendering that
+ * bitmap fonts get. for a window's stylesheet fonts, call this before
+ * rtb_window_reinit().
+ */
+void rtb_font_manager_use_distance_fields(struct rtb_font_manager *,
+		int enable);
+
+/**
+ * puts glyphs rasterised by the prewarm thread into the atlas. glyphs
+ * needed before then are rasterised on demand, as they always have been,
+ * so this only has to happen once in a while. returns the number of fonts
+ * that had glyphs added.
+ */
+int rtb_font_manager_add_prewarmed_glyphs(struct rtb_font_manager *);
+
 int rtb_font_manager_init(struct rtb_font_manager *, int dpi_x, int dpi_y);
 void rtb_font_manager_fini(struct rtb_font_manager *);
@@ -59,3 +59,12 @@ void rtb_layout_hpack_center(struct rtb_element *);
 void rtb_layout_hpack_right(struct rtb_element *);
 
 void rtb_layout_hdistribute(struct rtb_element *);
+
+/**
+ * lay children out in a row (hflex) or a column (vflex), growing and
+ * shrinking them to fill the parent according to the flex-grow and
+ * flex-shrink stylesheet properties, within their min/max-width and
+ * min/max-height. `inner_pad` (or the `gap` property) separates them.
+ */
+void rtb_layout_hflex(struct rtb_element *);
+void rtb_layout_vflex(struct rtb_element *);
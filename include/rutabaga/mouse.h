@@ -88,6 +88,8 @@ struct rtb_mouse_event {
 		} wheel;
 	};
 
+	/* in window coordinates. rtb_surface_to_content() brings it into
+	 * the same coordinates as an element's rect. */
 	struct rtb_point cursor;
 };
 
@@ -102,6 +104,17 @@ struct rtb_drag_event {
 	} delta;
 };
 
+/**
+ * motion history
+ */
+
+#define RTB_MOUSE_MOTION_HISTORY 64
+
+struct rtb_mouse_motion {
+	RTB_INHERIT(rtb_point);
+	uint64_t timestamp;
+};
+
 /**
  * internal mouse structure
  */
@@ -110,6 +123,21 @@ struct rtb_mouse {
 	RTB_INHERIT(rtb_point);
 	struct rtb_point previous;
 
+	/* with `coalesce_motion` set, motion events from the platform are
+	 * only recorded as they come in and get dispatched together, as
+	 * one event, once per frame (or before the next press, release,
+	 * wheel or crossing event, so that ordering is kept). `history`
+	 * holds the raw positions that went into the current motion, oldest
+	 * first. if more than RTB_MOUSE_MOTION_HISTORY arrive in a frame,
+	 * the oldest are dropped. */
+	int coalesce_motion;
+	int motion_pending;
+
+	struct {
+		struct rtb_mouse_motion samples[RTB_MOUSE_MOTION_HISTORY];
+		int count;
+	} history;
+
 	struct rtb_element *element_underneath;
 
 	struct rtb_mouse_button {
@@ -135,3 +163,25 @@ rtb_mouse_set_cursor(struct rtb_window *, struct rtb_mouse *,
 
 void
 rtb_mouse_unset_cursor(struct rtb_window *, struct rtb_mouse *);
+
+/**
+ * turns motion coalescing (see struct rtb_mouse above) on or off. off
+ * by default. turning it off dispatches any motion that's pending.
+ */
+void
+rtb_mouse_set_motion_coalescing(struct rtb_window *, struct rtb_mouse *,
+		int coalesce);
+
+/**
+ * returns the raw pointer positions that make up the motion currently
+ * being dispatched, oldest first, and stores how many there are in
+ * `count`. the last one is always the position the motion was
+ * dispatched with.
+ *
+ * only meaningful from inside a handler for a motion-driven event
+ * (RTB_DRAG_MOTION, RTB_MOUSE_ENTER, etc). widgets that want every
+ * sample of a fast stroke, rather than where it ended up, can use this
+ * to recover them when coalescing is on.
+ */
+const struct rtb_mouse_motion *
+rtb_mouse_get_motion_history(struct rtb_mouse *, int *count);
@@ -44,6 +44,12 @@ void rtb__platform_mouse_release(struct rtb_window *,
 		int buttons, int x, int y);
 void rtb__platform_mouse_motion(struct rtb_window *, int x, int y);
 
+/**
+ * dispatches any motion held back by motion coalescing. platforms call
+ * this once per frame, before drawing.
+ */
+void rtb__platform_mouse_flush_motion(struct rtb_window *);
+
 void rtb__platform_mouse_wheel(struct rtb_window *, int x, int y, float delta);
 
 void rtb__platform_mouse_enter_window(struct rtb_window *, int x, int y);
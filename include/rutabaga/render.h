@@ -35,12 +35,101 @@ struct rtb_render_context;
 #include "rutabaga/mat4.h"
 
 #include "bsd/queue.h"
+#include "wwrl/vector.h"
+
+struct rtb_surface;
+struct rtb_font;
+
+/**
+ * batched geometry.
+ *
+ * stylequads don't draw immediately. instead, their triangles are appended
+ * to the render context's batch and drawn in as few draw calls as possible
+ * when something else needs the GL (another shader, a glClear, a different
+ * texture) or when the surface has finished drawing its children.
+ *
+ * `layer` is negative for untextured (solid colour) vertices.
+ */
+
+struct rtb_render_vertex {
+	GLfloat x, y;
+	GLfloat s, t;
+	GLfloat r, g, b, a;
+	GLfloat layer;
+};
+
+/**
+ * text is batched the same way, but in a stream of its own since it needs
+ * the text shader. the quad batch is always drawn before the text batch,
+ * so a stylequad landing on top of text that's still waiting to be drawn
+ * flushes both first.
+ *
+ * text vertices are already offset to where the text is drawn and
+ * clipped to the element drawing it.
+ */
+
+struct rtb_text_vertex {
+	GLfloat x, y;
+	GLfloat s, t;
+	GLfloat shift;
+	GLfloat r, g, b, a;
+};
+
+struct rtb_batch_shader {
+	RTB_INHERIT(rtb_shader);
+
+	GLint vertex_color;
+	GLint tex_layer;
+};
 
 struct rtb_render_context {
 	struct rtb_window *window;
+	struct rtb_surface *surface;
 	struct rtb_shader *shader;
 
 	mat4 projection;
+
+	/* the element most recently pushed. its scissor and blend state are
+	 * only applied to the GL once something actually draws outside of
+	 * the batch. */
+	struct rtb_element *target;
+	int target_applied;
+
+	struct rtb_render_batch {
+		VECTOR(rtb_render_vertices, struct rtb_render_vertex) vertices;
+		GLuint vbo;
+
+		/* texture bound for every textured vertex in the batch, or 0
+		 * if there aren't any yet. */
+		GLuint texture;
+
+		/* union of the elements drawn into the batch, used as the
+		 * scissor rectangle when flushing. */
+		struct rtb_rect bounds;
+	} batch;
+
+	struct rtb_text_batch {
+		VECTOR(rtb_text_vertices, struct rtb_text_vertex) vertices;
+		GLuint vbo;
+
+		/* a font standing in for every glyph in the batch, which all
+		 * share its atlas, shader and gamma. NULL if the batch is empty. */
+		const struct rtb_font *font;
+
+		/* the area covered by each text drawn into the batch, so that
+		 * quads can be tested against them, and their union. */
+		VECTOR(rtb_text_rects, struct rtb_rect) rects;
+		struct rtb_rect bounds;
+	} text;
+
+	/* while a scrolled surface draws the strip that has just come into
+	 * view, everything drawn into it gets clipped to that strip. */
+	struct rtb_rect clip;
+	int clipping;
+
+	/* when zero, stylequads and text are drawn immediately rather than
+	 * batched. only really useful for comparing the two. */
+	int batching;
 };
 
 void rtb_render_use_style_bg(struct rtb_render_context *ctx,
@@ -58,8 +147,23 @@ void rtb_render_quad_outline(struct rtb_render_context *, struct rtb_quad *);
 void rtb_render_quad(struct rtb_render_context *, struct rtb_quad *);
 void rtb_render_clear(struct rtb_element *);
 
+void rtb_render_batch_add(struct rtb_render_context *,
+		struct rtb_element *on, GLuint texture,
+		const struct rtb_render_vertex *vertices, size_t count);
+void rtb_render_flush(struct rtb_render_context *);
+
+struct rtb_text_vertex *rtb_render_text_reserve(struct rtb_render_context *,
+		const struct rtb_font *font, size_t count);
+void rtb_render_text_commit(struct rtb_render_context *,
+		const struct rtb_rect *area, size_t count);
+
+void rtb_render_scissor(struct rtb_render_context *, const struct rtb_rect *);
 void rtb_render_use_shader(struct rtb_render_context *, struct rtb_shader *);
 void rtb_render_reset(struct rtb_element *);
 void rtb_render_push(struct rtb_element *);
 void rtb_render_pop(struct rtb_element *);
 struct rtb_render_context *rtb_render_get_context(struct rtb_element *);
+
+int rtb_render_context_init(struct rtb_render_context *,
+		struct rtb_surface *);
+void rtb_render_context_fini(struct rtb_render_context *);
@@ -43,6 +43,30 @@ typedef enum {
 	RTB_STYLE_PROP_TYPE_COUNT
 } rtb_style_prop_type_t;
 
+/* every property the stylesheet compiler knows about. it tags each
+ * property definition with its key, so that lookups are an array index
+ * rather than a string comparison. */
+typedef enum {
+	RTB_STYLE_KEY_UNKNOWN = 0,
+
+	RTB_STYLE_KEY_COLOR,
+	RTB_STYLE_KEY_BACKGROUND_COLOR,
+	RTB_STYLE_KEY_BACKGROUND_IMAGE,
+	RTB_STYLE_KEY_BORDER_IMAGE,
+	RTB_STYLE_KEY_BORDER_COLOR,
+	RTB_STYLE_KEY_MIN_WIDTH,
+	RTB_STYLE_KEY_MIN_HEIGHT,
+	RTB_STYLE_KEY_MAX_WIDTH,
+	RTB_STYLE_KEY_MAX_HEIGHT,
+	RTB_STYLE_KEY_FLEX_GROW,
+	RTB_STYLE_KEY_FLEX_SHRINK,
+	RTB_STYLE_KEY_GAP,
+	RTB_STYLE_KEY_FONT,
+	RTB_STYLE_KEY_KNOB_ROTOR,
+
+	RTB_STYLE_KEY_COUNT
+} rtb_style_key_t;
+
 typedef enum {
 	RTB_TEXTURE_VERTICAL_STRETCH   = 0x0,
 	RTB_TEXTURE_HORIZONTAL_STRETCH = 0x0,
@@ -83,6 +107,30 @@ struct rtb_style_texture_definition {
 	} border;
 };
 
+/* where one texture ended up in a style atlas, in normalized texture
+ * coordinates. */
+struct rtb_style_atlas_region {
+	const struct rtb_style_texture_definition *def;
+	GLfloat s, t, s2, t2;
+};
+
+/* every texture asset of a resolved style list, packed into a single
+ * GL texture so that stylequads don't each need their own. style lists
+ * are shared between windows but GL textures aren't, so the placements
+ * are kept here rather than in the texture definitions. */
+struct rtb_style_atlas {
+	GLuint gl_handle;
+	int w, h;
+
+	/* different for every build of every window's atlas, so that
+	 * stylequads can tell when theirs has changed. */
+	unsigned int generation;
+
+	/* sorted by `def`. */
+	struct rtb_style_atlas_region *regions;
+	int nregions;
+};
+
 struct rtb_rgb_color {
 	GLfloat r, g, b, a;
 };
@@ -94,6 +142,7 @@ struct rtb_rgb_color {
 struct rtb_style_property_definition {
 	/* public *********************************/
 	char *property_name;
+	rtb_style_key_t key;
 	rtb_style_prop_type_t type;
 
 	union {
@@ -105,6 +154,13 @@ struct rtb_style_property_definition {
 	};
 };
 
+/* every keyed property an element in a given state sees, with
+ * inheritance and the FOCUS -> NORMAL state fallback already applied.
+ * a slot is NULL if nothing in the style's chain sets that property. */
+struct rtb_resolved_style {
+	const struct rtb_style_property_definition *props[RTB_STYLE_KEY_COUNT];
+};
+
 struct rtb_style {
 	/* public *********************************/
 	char *for_type;
@@ -113,18 +169,44 @@ struct rtb_style {
 	/* private ********************************/
 	struct rtb_style *inherit_from;
 	struct rtb_type_atom_descriptor *resolved_type;
+
+	/* this style's own properties, indexed by key. filled in by
+	 * rtb_style_resolve_list(). */
+	const struct rtb_style_property_definition
+		*by_key[RTB_DRAW_STATE_COUNT][RTB_STYLE_KEY_COUNT];
+
+	/* built from the above once the whole list is resolved. immutable
+	 * afterwards, so elements can compare them by pointer. */
+	struct rtb_resolved_style resolved[RTB_ELEM_STATE_COUNT];
 };
 
 /**
  * public API
  */
 
+const struct rtb_style_property_definition *rtb_style_query(
+		struct rtb_element *elem, rtb_style_key_t key,
+		rtb_style_prop_type_t type, int should_return_fallback);
+const struct rtb_style_property_definition *rtb_style_query_in_tree(
+		struct rtb_element *leaf, rtb_style_key_t key,
+		rtb_style_prop_type_t type, int should_return_fallback);
+
+/**
+ * by-name versions of the above. these look the key up and then do the
+ * same thing, though properties the stylesheet compiler doesn't know
+ * about can only be found this way.
+ */
 const struct rtb_style_property_definition *rtb_style_query_prop(
 		struct rtb_element *elem, const char *property_name,
 		rtb_style_prop_type_t type, int should_return_fallback);
 const struct rtb_style_property_definition *rtb_style_query_prop_in_tree(
 		struct rtb_element *leaf, const char *property_name,
 		rtb_style_prop_type_t type, int should_return_fallback);
+
+const struct rtb_resolved_style *rtb_style_resolved(struct rtb_style *style,
+		rtb_elem_state_t state);
+rtb_style_key_t rtb_style_key_for_name(const char *property_name);
+
 int rtb_style_elem_has_properties_for_state(struct rtb_element *elem,
 		rtb_elem_state_t state);
 
@@ -135,4 +217,8 @@ struct rtb_style *rtb_style_for_element(struct rtb_element *elem,
 
 int rtb_style_resolve_list(struct rtb_window *,
 		struct rtb_style *style_list);
+void rtb_style_atlas_fini(struct rtb_style_atlas *);
+const struct rtb_style_atlas_region *rtb_style_atlas_lookup(
+		const struct rtb_style_atlas *,
+		const struct rtb_style_texture_definition *);
 struct rtb_style *rtb_style_get_defaults(void);
@@ -32,10 +32,14 @@
 #include "rutabaga/quad.h"
 #include "rutabaga/mat4.h"
 
+struct rtb_style_atlas;
+
 struct rtb_stylequad {
 	struct rtb_point offset;
 
-	GLuint vertices;
+	/* 9-slice vertices, arranged around the center. these only live on
+	 * the CPU; nothing is uploaded until draw-time. */
+	GLfloat geometry[16][2];
 
 	struct {
 		const struct rtb_rgb_color *bg_color;
@@ -44,8 +48,15 @@ struct rtb_stylequad {
 
 	struct rtb_stylequad_texture {
 		const struct rtb_style_texture_definition *definition;
-		GLuint gl_handle;
-		GLuint coords;
+
+		/* in the sub-rectangle of the window's style atlas that the
+		 * texture was packed into. rtb_stylequad_resolve_atlas() fills
+		 * these in and records which build of the atlas they're for in
+		 * `atlas_generation` (0 until then). `in_atlas` is 0 if the
+		 * texture couldn't be found, in which case it isn't drawn. */
+		GLfloat tex_coords[16][2];
+		unsigned int atlas_generation;
+		int in_atlas;
 	} border_image, background_image;
 };
 
@@ -60,6 +71,15 @@ int rtb_stylequad_set_border_image(struct rtb_stylequad *,
 		const struct rtb_style_texture_definition *);
 int rtb_stylequad_set_background_image(struct rtb_stylequad *,
 		const struct rtb_style_texture_definition *);
+
+/**
+ * looks up where the stylequad's textures are in `atlas`, if it's been
+ * rebuilt or the textures have changed since last time. call this after
+ * setting the images and whenever the element is restyled.
+ */
+void rtb_stylequad_resolve_atlas(struct rtb_stylequad *,
+		const struct rtb_style_atlas *);
+
 int rtb_stylequad_set_background_color(struct rtb_stylequad *,
 		const struct rtb_rgb_color *);
 int rtb_stylequad_set_border_color(struct rtb_stylequad *,
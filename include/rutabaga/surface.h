@@ -41,23 +41,64 @@ typedef enum {
 	RTB_SURFACE_INVALID
 } rtb_surface_state_t;
 
+#define RTB_DAMAGE_MAX_RECTS 8
+
+/* a handful of rects, in the content coordinates of the surface they
+ * belong to (which, for the window, are window coordinates). when more
+ * come in than we have room for, they all get collapsed into their
+ * bounding box. */
+struct rtb_damage {
+	struct rtb_rect rects[RTB_DAMAGE_MAX_RECTS];
+	int count;
+};
+
 struct rtb_surface {
 	RTB_INHERIT(rtb_element);
 
+	/* public *********************************/
+
+	/* children are laid out in content coordinates, which match the
+	 * surface's own until it's scrolled. `scroll` is how far the content
+	 * has been moved up and to the left, so the part of it on show is
+	 * the surface's rect offset by `scroll`. */
+	struct rtb_point scroll;
+
 	/* private ********************************/
 	GLuint fbo;
 	GLuint texture;
+
+	/* scrolling moves what's already in `texture` over into
+	 * `spare_texture` and then swaps the two, so that only the strip that
+	 * has come into view needs drawing. `pending_scroll` is how far the
+	 * content has moved since it was last drawn. */
+	GLuint spare_fbo;
+	GLuint spare_texture;
+	struct rtb_point pending_scroll;
 	struct rtb_quad quad;
 
 	rtb_surface_state_t surface_state;
 
 	struct rtb_render_tailq render_queue;
 	struct rtb_render_context render_ctx;
+
+	/* what has changed on the surface since it was last drawn. */
+	struct rtb_damage damage;
 };
 
+void rtb_damage_add(struct rtb_damage *, const struct rtb_rect *);
+void rtb_damage_clear(struct rtb_damage *);
+
 int rtb_surface_is_dirty(struct rtb_surface *);
 
+void rtb_surface_damage(struct rtb_surface *, const struct rtb_rect *);
+
+void rtb_surface_scroll_to(struct rtb_surface *, float x, float y);
+void rtb_surface_scroll_by(struct rtb_surface *, float dx, float dy);
+void rtb_surface_view_rect(struct rtb_surface *, struct rtb_rect *view);
+void rtb_surface_to_content(struct rtb_surface *, struct rtb_point *);
+
 void rtb_surface_blit(struct rtb_surface *);
+void rtb_surface_blit_rect(struct rtb_surface *, const struct rtb_rect *);
 void rtb_surface_draw_children(struct rtb_surface *);
 void rtb_surface_invalidate(struct rtb_surface *);
 
@@ -32,14 +32,47 @@
 #include "rutabaga/style.h"
 #include "rutabaga/render.h"
 
-#include "freetype-gl/vertex-buffer.h"
+#include "wwrl/vector.h"
+
+/**
+ * a laid out string, shared between every text object showing the same
+ * text in the same font. runs live in their font manager's run table.
+ *
+ * glyph quads are relative to the top left of the text. they're turned
+ * into vertices in the render context's text batch when drawn.
+ */
+
+struct rtb_text_glyph {
+	GLfloat x0, y0, x1, y1;
+	GLfloat s0, t0, s1, t1;
+
+	/* how far past the pixel grid each side of the glyph falls, for
+	 * subpixel positioning in the text shader. */
+	GLfloat shift0, shift1;
+};
+
+struct rtb_text_run {
+	GLfloat w, h;
+	VECTOR(rtb_text_glyphs, struct rtb_text_glyph) glyphs;
+
+	struct rtb_font *font;
+	rtb_utf8_t *text;
+	uint32_t hash;
+
+	/* the glyph atlas can move or evict glyphs, in which case the run is
+	 * laid out again the next time it's used. */
+	unsigned int atlas_generation;
+
+	int refcount;
+	struct rtb_text_run *next;
+};
 
 struct rtb_text_object {
 	GLfloat w, h;
 
-	vertex_buffer_t *vertices;
 	struct rtb_font_manager *fm;
-	const struct rtb_font *font;
+	struct rtb_font *font;
+	struct rtb_text_run *run;
 };
 
 int rtb_text_object_get_glyph_rect(struct rtb_text_object *, int idx,
@@ -95,6 +95,7 @@ struct rtb_patchbay {
 		struct rtb_patchbay_port *from;
 		struct rtb_patchbay_port *to;
 
+		/* in the same coordinates as the nodes. */
 		struct rtb_point cursor;
 	} patch_in_progress;
 };
@@ -0,0 +1,110 @@
+/**
+ * rutabaga: an OpenGL widget toolkit
+ * Copyright (c) 2013 William Light.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "rutabaga/rutabaga.h"
+#include "rutabaga/element.h"
+#include "rutabaga/surface.h"
+
+#include "wwrl/vector.h"
+
+#define RTB_VIRTUAL_LIST(x) RTB_UPCAST(x, rtb_virtual_list)
+
+struct rtb_virtual_list;
+
+/**
+ * where a virtual list gets its items from. the list only keeps enough
+ * elements around to cover what's on screen (plus `overscan` rows
+ * either side), and reuses them as it scrolls, so `create` is called
+ * about once per visible row and `bind` once for every item that
+ * scrolls into view.
+ */
+struct rtb_virtual_list_source {
+	/* make a new, empty element to show items in. it'll be added to
+	 * the list as a child and sized by it. */
+	struct rtb_element *(*create)(struct rtb_virtual_list *, void *ctx);
+
+	/* fill `elem` in with item number `index`. `elem` may be showing
+	 * some other item at the time. */
+	void (*bind)(struct rtb_virtual_list *, struct rtb_element *elem,
+			int index, void *ctx);
+
+	/* get rid of an element made by `create`, once the list no longer
+	 * needs it. may be NULL, in which case the elements are just
+	 * detached and left to whoever made them. */
+	void (*destroy)(struct rtb_virtual_list *, struct rtb_element *elem,
+			void *ctx);
+};
+
+struct rtb_virtual_list_slot {
+	struct rtb_element *elem;
+	int index;
+};
+
+struct rtb_virtual_list {
+	RTB_INHERIT(rtb_surface);
+
+	/* public *********************************/
+	const struct rtb_virtual_list_source *source;
+	void *source_ctx;
+
+	int count;
+	int columns;
+	float item_height;
+	int overscan;
+
+	float scroll_offset;
+
+	/* private ********************************/
+	/* item `i` is shown by `slots[i % slots.size]`, if by anything. */
+	VECTOR(rtb_virtual_list_slots, struct rtb_virtual_list_slot) slots;
+
+	/* elements the list has grown out of, kept for if it needs more
+	 * again. detached. */
+	VECTOR(rtb_virtual_list_pool, struct rtb_element *) pool;
+};
+
+void rtb_virtual_list_set_source(struct rtb_virtual_list *,
+		const struct rtb_virtual_list_source *source, void *ctx);
+
+/**
+ * these all take effect on the next layout pass. rtb_virtual_list_reload()
+ * re-binds every item on screen, for when the data behind them has
+ * changed wholesale. rtb_virtual_list_item_changed() does just the one,
+ * straight away, if it's on screen.
+ */
+void rtb_virtual_list_set_count(struct rtb_virtual_list *, int count);
+void rtb_virtual_list_set_item_height(struct rtb_virtual_list *, float h);
+void rtb_virtual_list_set_columns(struct rtb_virtual_list *, int columns);
+void rtb_virtual_list_scroll_to(struct rtb_virtual_list *, float offset);
+void rtb_virtual_list_reload(struct rtb_virtual_list *);
+void rtb_virtual_list_item_changed(struct rtb_virtual_list *, int index);
+
+int rtb_virtual_list_init(struct rtb_virtual_list *);
+void rtb_virtual_list_fini(struct rtb_virtual_list *);
+struct rtb_virtual_list *rtb_virtual_list_new(void);
+void rtb_virtual_list_free(struct rtb_virtual_list *);
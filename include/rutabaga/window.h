@@ -30,6 +30,7 @@
 
 #include "rutabaga/types.h"
 #include "rutabaga/element.h"
+#include "rutabaga/style.h"
 #include "rutabaga/shader.h"
 #include "rutabaga/surface.h"
 #include "rutabaga/mouse.h"
@@ -41,9 +42,54 @@
 
 #define RTB_WINDOW_EVENT(x) RTB_UPCAST(x, rtb_window_event)
 
+#define RTB_WINDOW_DAMAGE_HISTORY 4
+
+/* how many frames of GPU timer queries can be in flight. results are
+ * read back this many frames late so that we never wait on the GPU. */
+#define RTB_FRAME_STATS_QUERIES 4
+
+/**
+ * what a frame cost. everything is counted from the end of the previous
+ * frame to the end of this one, so work done while handling events
+ * between frames (layout, coalescing) is charged to the next frame.
+ */
+struct rtb_frame_stats {
+	/* CPU time, in nanoseconds. `event_ns` is reported by the platform
+	 * and is 0 on platforms that don't measure it. it includes any
+	 * layout done while handling events, which also shows up in
+	 * `layout_ns`. */
+	uint64_t event_ns;
+	uint64_t layout_ns;
+	uint64_t draw_ns;
+
+	/* GPU time, in nanoseconds, of the frame RTB_FRAME_STATS_QUERIES
+	 * frames before this one. 0 if the GL has no timer queries or no
+	 * result has come back yet. */
+	uint64_t gpu_ns;
+
+	unsigned int draw_calls;
+
+	/* vertex data streamed to the GL while drawing. */
+	unsigned int buffer_uploads;
+	unsigned int elements_drawn;
+
+	/* elements taken off of render queues, and elements that didn't
+	 * need to go on one because an ancestor was already queued. */
+	unsigned int render_queue_length;
+	unsigned int coalesced_redraws;
+
+	/* pointer motion events folded into a later one by motion
+	 * coalescing (see rtb_mouse_set_motion_coalescing()). */
+	unsigned int coalesced_motions;
+};
+
 struct rtb_window_event {
 	RTB_INHERIT(rtb_event);
 	struct rtb_window *window;
+
+	/* for RTB_FRAME_END, the frame that just finished. for
+	 * RTB_FRAME_START, the one before it. */
+	const struct rtb_frame_stats *stats;
 };
 
 struct rtb_window_local_storage {
@@ -51,6 +97,7 @@ struct rtb_window_local_storage {
 		struct rtb_shader dfault;
 		struct rtb_shader surface;
 		struct rtb_shader stylequad;
+		struct rtb_batch_shader batch;
 	} shader;
 
 	struct {
@@ -65,6 +112,10 @@ struct rtb_window_local_storage {
 			GLuint outline;
 		} quad;
 	} ibo;
+
+	struct {
+		GLuint stylequad;
+	} vbo;
 };
 
 struct rtb_window {
@@ -85,9 +136,35 @@ struct rtb_window {
 	struct rutabaga *rtb;
 
 	GLuint vao;
+	struct rtb_style_atlas style_atlas;
 
 	int need_reconfigure;
 	int dirty;
+
+	/* set by the platform before each frame to the age of the back
+	 * buffer: how many frames ago its contents were presented, so 1
+	 * means it holds the last frame. 0 if it's unknown. lets us repaint
+	 * only what has changed since that buffer was presented. */
+	int buffer_age;
+	struct rtb_damage damage_history[RTB_WINDOW_DAMAGE_HISTORY];
+
+	/* `frame_stats` is the frame in progress, which anything that
+	 * draws or uploads counts itself into. */
+	struct rtb_frame_stats frame_stats;
+	struct rtb_frame_stats last_frame_stats;
+
+	struct {
+		GLuint queries[RTB_FRAME_STATS_QUERIES];
+		unsigned int frame;
+		int supported;
+	} gpu_timer;
+
+	struct {
+		struct rtb_text_object *text;
+		struct rtb_rect rect;
+		int visible;
+	} stats_overlay;
+
 	uv_mutex_t lock;
 
 	struct rtb_mouse mouse;
@@ -111,6 +188,26 @@ void rtb_window_unlock(struct rtb_window *);
 
 void rtb_window_reinit(struct rtb_window *);
 
+/**
+ * stats for the most recently finished frame. see struct rtb_frame_stats.
+ */
+const struct rtb_frame_stats *rtb_window_get_frame_stats(
+		struct rtb_window *);
+
+/**
+ * draws the previous frame's stats in the top left corner of the window.
+ */
+void rtb_window_show_frame_stats(struct rtb_window *, int show);
+
+/**
+ * copies what's currently in the window's framebuffer into `dest` as
+ * RGBA, 4 bytes per pixel, top row first. `dest` has to have room for
+ * w * h * 4 bytes. the window has to be locked.
+ *
+ * returns 0 on success, -1 on failure.
+ */
+int rtb_window_read_pixels(struct rtb_window *, uint8_t *dest);
+
 struct rtb_window *rtb_window_open_under(struct rutabaga *,
 		intptr_t parent, int width, int height, const char *title);
 struct rtb_window *rtb_window_open(struct rutabaga *,
@@ -0,0 +1,299 @@
+/**
+ * rutabaga: an OpenGL widget toolkit
+ * Copyright (c) 2013 William Light.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "rutabaga/rutabaga.h"
+#include "rutabaga/element.h"
+#include "rutabaga/geometry.h"
+
+#include "rtb_private/child-grid.h"
+
+/* below this many children a linear walk is as fast as the grid. */
+#define GRID_MIN_CHILDREN 16
+
+/* upper bound on cells per axis, so that a parent with a pathological
+ * number of children doesn't get a pathological number of cells. */
+#define GRID_MAX_CELLS_PER_AXIS 64
+
+struct rtb_child_grid {
+	int stale;
+
+	/* 0 if the children are few enough (or the last build failed) that
+	 * we should fall back to walking the list. */
+	int usable;
+
+	float x, y;
+	float x2, y2;
+	float cell_w, cell_h;
+	int cols, rows;
+
+	/* the children in list order, so that the highest index that
+	 * matches is the topmost child. */
+	struct rtb_element **elems;
+	unsigned nelems, elems_size;
+
+	/* cell `c` holds entries[cell_start[c]] to entries[cell_start[c + 1]],
+	 * which are indices into `elems` in ascending order. */
+	unsigned *cell_start;
+	unsigned cells_size;
+
+	unsigned *entries;
+	unsigned entries_size;
+};
+
+/**
+ * private stuff
+ */
+
+static int
+reserve(void **buf, unsigned *size, unsigned want, size_t elem_size)
+{
+	void *n;
+
+	if (want <= *size)
+		return 0;
+
+	if (!(n = realloc(*buf, want * elem_size)))
+		return -1;
+
+	*buf = n;
+	*size = want;
+	return 0;
+}
+
+static int
+clamp_cell(float offset, float cell, int ncells)
+{
+	int c = (int) floorf(offset / cell);
+
+	if (c < 0)
+		return 0;
+	if (c >= ncells)
+		return ncells - 1;
+	return c;
+}
+
+static int
+child_is_hittable(const struct rtb_element *child)
+{
+	return child->x2 >= child->x && child->y2 >= child->y;
+}
+
+static int
+build(struct rtb_child_grid *grid, struct rtb_element *parent)
+{
+	struct rtb_element *iter;
+	unsigned i, n, ncells, nentries;
+	int c0, c1, r0, r1, c, r, axis;
+
+	grid->usable = 0;
+	grid->stale = 0;
+
+	n = 0;
+	TAILQ_FOREACH(iter, &parent->children, child)
+		n++;
+
+	if (n < GRID_MIN_CHILDREN)
+		return 0;
+
+	if (reserve((void **) &grid->elems, &grid->elems_size,
+				n, sizeof(*grid->elems)))
+		return -1;
+
+	grid->x = grid->y = INFINITY;
+	grid->x2 = grid->y2 = -INFINITY;
+
+	n = 0;
+	TAILQ_FOREACH(iter, &parent->children, child) {
+		if (!child_is_hittable(iter))
+			continue;
+
+		grid->elems[n++] = iter;
+
+		grid->x  = fminf(grid->x,  iter->x);
+		grid->y  = fminf(grid->y,  iter->y);
+		grid->x2 = fmaxf(grid->x2, iter->x2);
+		grid->y2 = fmaxf(grid->y2, iter->y2);
+	}
+
+	grid->nelems = n;
+
+	if (!n) {
+		grid->usable = 1;
+		return 0;
+	}
+
+	axis = (int) ceilf(sqrtf(n));
+	if (axis > GRID_MAX_CELLS_PER_AXIS)
+		axis = GRID_MAX_CELLS_PER_AXIS;
+
+	grid->cols = grid->rows = axis;
+	grid->cell_w = fmaxf((grid->x2 - grid->x) / axis, 1.f);
+	grid->cell_h = fmaxf((grid->y2 - grid->y) / axis, 1.f);
+
+	ncells = axis * axis;
+	if (reserve((void **) &grid->cell_start, &grid->cells_size,
+				ncells + 1, sizeof(*grid->cell_start)))
+		return -1;
+
+	for (c = 0; c <= (int) ncells; c++)
+		grid->cell_start[c] = 0;
+
+	/* first pass: count how many children land in each cell. */
+
+#define CHILD_CELL_SPAN(elem) do {                                    \
+	c0 = clamp_cell(elem->x  - grid->x, grid->cell_w, grid->cols);    \
+	c1 = clamp_cell(elem->x2 - grid->x, grid->cell_w, grid->cols);    \
+	r0 = clamp_cell(elem->y  - grid->y, grid->cell_h, grid->rows);    \
+	r1 = clamp_cell(elem->y2 - grid->y, grid->cell_h, grid->rows);    \
+} while (0)
+
+	for (i = 0; i < n; i++) {
+		CHILD_CELL_SPAN(grid->elems[i]);
+
+		for (r = r0; r <= r1; r++)
+			for (c = c0; c <= c1; c++)
+				grid->cell_start[(r * grid->cols) + c + 1]++;
+	}
+
+	for (c = 0; c < (int) ncells; c++)
+		grid->cell_start[c + 1] += grid->cell_start[c];
+
+	nentries = grid->cell_start[ncells];
+	if (reserve((void **) &grid->entries, &grid->entries_size,
+				nentries, sizeof(*grid->entries)))
+		return -1;
+
+	/* second pass: fill them in. cell_start[c] is used as the insertion
+	 * cursor for cell c - 1 and ends up pointing at the start of cell c,
+	 * which is exactly where it should be. */
+
+	for (c = ncells; c > 0; c--)
+		grid->cell_start[c] = grid->cell_start[c - 1];
+	grid->cell_start[0] = 0;
+
+	for (i = 0; i < n; i++) {
+		CHILD_CELL_SPAN(grid->elems[i]);
+
+		for (r = r0; r <= r1; r++)
+			for (c = c0; c <= c1; c++)
+				grid->entries[grid->cell_start[(r * grid->cols) + c + 1]++] = i;
+	}
+
+#undef CHILD_CELL_SPAN
+
+	grid->usable = 1;
+	return 0;
+}
+
+static struct rtb_element *
+linear_hit(struct rtb_element *parent, const struct rtb_point *pt)
+{
+	struct rtb_element *iter;
+
+	TAILQ_FOREACH_REVERSE(iter, &parent->children, children, child)
+		if (iter->visibility != RTB_FULLY_OBSCURED
+				&& RTB_POINT_IN_RECT(*pt, *iter))
+			return iter;
+
+	return NULL;
+}
+
+/**
+ * public API
+ */
+
+struct rtb_element *
+rtb_child_grid_hit(struct rtb_element *parent, const struct rtb_point *pt)
+{
+	struct rtb_child_grid *grid = parent->child_grid;
+	struct rtb_element *child;
+	unsigned first, last, cell;
+
+	if (TAILQ_EMPTY(&parent->children))
+		return NULL;
+
+	if (!grid) {
+		if (!(grid = calloc(1, sizeof(*grid))))
+			return linear_hit(parent, pt);
+
+		grid->stale = 1;
+		parent->child_grid = grid;
+	}
+
+	if (grid->stale && build(grid, parent))
+		grid->usable = 0;
+
+	if (!grid->usable)
+		return linear_hit(parent, pt);
+
+	if (!grid->nelems
+			|| pt->x < grid->x || pt->x > grid->x2
+			|| pt->y < grid->y || pt->y > grid->y2)
+		return NULL;
+
+	cell =
+		(clamp_cell(pt->y - grid->y, grid->cell_h, grid->rows) * grid->cols)
+		+ clamp_cell(pt->x - grid->x, grid->cell_w, grid->cols);
+
+	first = grid->cell_start[cell];
+	last  = grid->cell_start[cell + 1];
+
+	while (last-- > first) {
+		child = grid->elems[grid->entries[last]];
+
+		if (child->visibility != RTB_FULLY_OBSCURED
+				&& RTB_POINT_IN_RECT(*pt, *child))
+			return child;
+	}
+
+	return NULL;
+}
+
+void
+rtb_child_grid_invalidate(struct rtb_element *parent)
+{
+	if (parent->child_grid)
+		parent->child_grid->stale = 1;
+}
+
+void
+rtb_child_grid_free(struct rtb_element *parent)
+{
+	struct rtb_child_grid *grid = parent->child_grid;
+
+	if (!grid)
+		return;
+
+	free(grid->elems);
+	free(grid->cell_start);
+	free(grid->entries);
+	free(grid);
+
+	parent->child_grid = NULL;
+}
@@ -46,6 +46,7 @@
 
 #include "rtb_private/stdlib-allocator.h"
 #include "rtb_private/layout-debug.h"
+#include "rtb_private/child-grid.h"
 
 #include "wwrl/vector.h"
 
@@ -163,10 +164,187 @@ transition_unfocus(struct rtb_element *self)
 	}
 }
 
+/**
+ * visibility
+ */
+
+/* the part of `surface`'s content that can end up in the window: what
+ * it has on show, cut down by what the surfaces it's inside have on show.
+ * the result is in `surface`'s content coordinates, so every surface on
+ * the way up shifts the ones above it by its scroll. */
+static void
+surface_clip(struct rtb_surface *surface, struct rtb_rect *clip)
+{
+	struct rtb_point offset = {0.f, 0.f};
+	struct rtb_rect view;
+
+	rtb_surface_view_rect(surface, clip);
+
+	while (surface->surface != surface) {
+		offset.x += surface->scroll.x;
+		offset.y += surface->scroll.y;
+		surface = surface->surface;
+
+		rtb_surface_view_rect(surface, &view);
+
+		clip->x  = fmax(clip->x,  view.x  + offset.x);
+		clip->y  = fmax(clip->y,  view.y  + offset.y);
+		clip->x2 = fmin(clip->x2, view.x2 + offset.x);
+		clip->y2 = fmin(clip->y2, view.y2 + offset.y);
+	}
+}
+
+static rtb_visibility_t
+visibility_in(const struct rtb_rect *rect, const struct rtb_rect *clip)
+{
+	if (rect->x >= clip->x2 || rect->x2 <= clip->x
+			|| rect->y >= clip->y2 || rect->y2 <= clip->y)
+		return RTB_FULLY_OBSCURED;
+
+	if (rect->x >= clip->x && rect->x2 <= clip->x2
+			&& rect->y >= clip->y && rect->y2 <= clip->y2)
+		return RTB_UNOBSCURED;
+
+	return RTB_PARTIALLY_OBSCURED;
+}
+
+static void
+set_visibility(struct rtb_element *self, const struct rtb_rect *clip)
+{
+	rtb_visibility_t was = self->visibility;
+
+	self->visibility = visibility_in(&self->rect, clip);
+
+	/* restyle() passes over elements that can't be seen, so catch up
+	 * with any that it missed now that this one can be. */
+	if (was == RTB_FULLY_OBSCURED && self->visibility != RTB_FULLY_OBSCURED
+			&& self->need_restyle) {
+		self->need_restyle = 0;
+		self->restyle(self);
+	}
+}
+
+static int
+is_window(struct rtb_element *self)
+{
+	/* the window gets its visibility from the platform. */
+	return !self->surface || RTB_ELEMENT(self->surface) == self;
+}
+
+static void
+update_visibility(struct rtb_element *self)
+{
+	struct rtb_rect clip;
+
+	if (is_window(self))
+		return;
+
+	surface_clip(self->surface, &clip);
+	set_visibility(self, &clip);
+}
+
+/* everything drawn into the same surface shares a clip, so it only gets
+ * worked out again when we cross into another one. */
+static void
+update_tree_visibility(struct rtb_element *self, const struct rtb_rect *clip)
+{
+	struct rtb_element *iter = TAILQ_FIRST(&self->children);
+	struct rtb_rect child_clip;
+
+	set_visibility(self, clip);
+
+	if (!iter)
+		return;
+
+	if (iter->surface != self->surface) {
+		surface_clip(iter->surface, &child_clip);
+		clip = &child_clip;
+	}
+
+	TAILQ_FOREACH(iter, &self->children, child)
+		update_tree_visibility(iter, clip);
+}
+
+/* until an element has been laid out where it's going, we don't know
+ * whether it can be seen, so assume it can. */
+static void
+reset_visibility(struct rtb_element *self)
+{
+	struct rtb_element *iter;
+
+	self->visibility = RTB_UNOBSCURED;
+	self->need_restyle = 0;
+
+	TAILQ_FOREACH(iter, &self->children, child)
+		reset_visibility(iter);
+}
+
 /**
  * reflow
  */
 
+static void
+invalidate_layout(struct rtb_element *self)
+{
+	/* measurements are cached all the way up, and an ancestor's can
+	 * depend on ours even when the ones in between don't change size,
+	 * so this always goes to the root. */
+	for (; self; self = self->parent) {
+		self->need_measure = 1;
+		self->need_layout  = 1;
+	}
+}
+
+/* no real rect has a negative size, so this makes the next layout pass
+ * treat the element as having moved and give it a full reflow. */
+static void
+forget_layout(struct rtb_element *self)
+{
+	self->laid_out.w = self->laid_out.h = -1.f;
+}
+
+static int
+has_moved(const struct rtb_element *self)
+{
+	return self->x != self->laid_out.x || self->y != self->laid_out.y
+		|| self->w != self->laid_out.w || self->h != self->laid_out.h;
+}
+
+static int
+needs_reflow(const struct rtb_element *self)
+{
+	return self->need_layout || has_moved(self);
+}
+
+/* the deferred layout pass. lays `self` out again and works down the
+ * tree from there, following `need_layout` to the elements that asked
+ * for it. children that end up somewhere new get a full reflow. the
+ * ones that don't are left alone (or, if they're marked, handled the
+ * same way as `self`), which keeps us from reallocating surfaces and
+ * redrawing things that haven't changed. */
+static void
+layout_marked(struct rtb_element *self)
+{
+	struct rtb_element *iter;
+	int moved = 0;
+
+	self->need_layout = 0;
+	self->layout_cb(self);
+
+	TAILQ_FOREACH(iter, &self->children, child) {
+		if (has_moved(iter)) {
+			iter->reflow(iter, self, RTB_DIRECTION_LEAFWARD);
+			moved = 1;
+		} else if (iter->need_layout)
+			layout_marked(iter);
+	}
+
+	/* our children's old positions need painting over along with their
+	 * new ones, and our rect covers both. */
+	if (moved)
+		rtb_elem_mark_dirty(self);
+}
+
 static int
 reflow_rootward(struct rtb_element *self,
 		struct rtb_element *instigator, rtb_ev_direction_t direction)
@@ -186,7 +364,8 @@ reflow_rootward(struct rtb_element *self,
 		return 0;
 
 	TAILQ_FOREACH(iter, &self->children, child)
-		iter->reflow(iter, self, RTB_DIRECTION_LEAFWARD);
+		if (needs_reflow(iter))
+			iter->reflow(iter, self, RTB_DIRECTION_LEAFWARD);
 
 	if (self->parent)
 		self->parent->reflow(self->parent, self, direction);
@@ -203,8 +382,11 @@ reflow_leafward(struct rtb_element *self,
 
 	self->layout_cb(self);
 
+	/* children that are where they were last time and have nothing new
+	 * to lay out can be left alone, along with everything under them. */
 	TAILQ_FOREACH(iter, &self->children, child)
-		iter->reflow(iter, self, direction);
+		if (needs_reflow(iter))
+			iter->reflow(iter, self, direction);
 }
 
 static int
@@ -213,6 +395,15 @@ reflow(struct rtb_element *self,
 {
 	rtb_rect_update_points_from_size(&self->rect);
 
+	/* our rect (and, once layout_cb has run, our children's) may have
+	 * moved, so any hit-testing grid that covers them is out of date. */
+	rtb_child_grid_invalidate(self);
+	if (self->parent)
+		rtb_child_grid_invalidate(self->parent);
+
+	self->laid_out = self->rect;
+	self->need_layout = 0;
+
 	self->inner_rect.x  = self->x  + self->outer_pad.x;
 	self->inner_rect.y  = self->y  + self->outer_pad.y;
 	self->inner_rect.x2 = self->x2 - self->outer_pad.x;
@@ -220,6 +411,7 @@ reflow(struct rtb_element *self,
 	rtb_rect_update_size_from_points(&self->inner_rect);
 
 	rtb_stylequad_update_geometry(&self->stylequad, &self->rect);
+	update_visibility(self);
 
 	switch (direction) {
 	case RTB_DIRECTION_ROOTWARD:
@@ -239,18 +431,76 @@ reflow(struct rtb_element *self,
  * styling
  */
 
+static void
+update_opaque_ancestor(struct rtb_element *self)
+{
+	struct rtb_element *parent = self->parent;
+
+	/* XXX: shouldn't depend on stylequad like this */
+
+	if (!parent || parent == RTB_ELEMENT(self->surface))
+		self->opaque_ancestor = NULL;
+	else if (parent->opaque_ancestor)
+		self->opaque_ancestor = parent->opaque_ancestor;
+	else if (parent->stylequad.properties.bg_color)
+		self->opaque_ancestor = parent;
+	else
+		self->opaque_ancestor = NULL;
+}
+
+static void
+update_opaque_ancestors(struct rtb_element *self)
+{
+	struct rtb_element *iter;
+
+	update_opaque_ancestor(self);
+
+	TAILQ_FOREACH(iter, &self->children, child)
+		update_opaque_ancestors(iter);
+}
+
+/* the property `to` has for `key`, or NULL if `from` already had the
+ * same one (or `to` doesn't have one at all). */
+static const struct rtb_style_property_definition *
+changed_prop(const struct rtb_resolved_style *from,
+		const struct rtb_resolved_style *to, rtb_style_key_t key,
+		rtb_style_prop_type_t type)
+{
+	const struct rtb_style_property_definition *prop = to->props[key];
+
+	if (!prop || prop->type != type)
+		return NULL;
+
+	if (from && from->props[key] == prop)
+		return NULL;
+
+	return prop;
+}
+
 static void
 reload_style(struct rtb_element *self)
 {
 	const struct rtb_style_property_definition *prop;
+	const struct rtb_resolved_style *from, *to;
+	const struct rtb_rgb_color *old_bg_color;
+	struct rtb_element *iter;
 	int need_reflow = 0;
 
+	from = self->resolved_style;
+	to = rtb_style_resolved(self->style, self->state);
+
+	/* resolved styles are immutable, so if we're looking at the same
+	 * one as last time then there's nothing to reload. */
+	if (!to || to == from)
+		return;
+
+	self->resolved_style = to;
+
 	/* layout-related properties trigger a reflow if they change, so
 	 * we'll handle them first. */
 
-#define ASSIGN_LAYOUT_FLOAT(pname, dest) do {                         \
-	prop = rtb_style_query_prop(self,                                 \
-			pname, RTB_STYLE_PROP_FLOAT, 0);                          \
+#define ASSIGN_LAYOUT_FLOAT(key, dest) do {                           \
+	prop = changed_prop(from, to, key, RTB_STYLE_PROP_FLOAT);         \
 	if (!prop)                                                        \
 		break;                                                        \
 	if (self->dest != prop->flt                                       \
@@ -261,37 +511,54 @@ reload_style(struct rtb_element *self)
 		self->dest = prop->flt;                                       \
 } while (0)
 
-	ASSIGN_LAYOUT_FLOAT("min-width", min_size.w);
-	ASSIGN_LAYOUT_FLOAT("min-height", min_size.h);
+	ASSIGN_LAYOUT_FLOAT(RTB_STYLE_KEY_MIN_WIDTH, min_size.w);
+	ASSIGN_LAYOUT_FLOAT(RTB_STYLE_KEY_MIN_HEIGHT, min_size.h);
+	ASSIGN_LAYOUT_FLOAT(RTB_STYLE_KEY_MAX_WIDTH, max_size.w);
+	ASSIGN_LAYOUT_FLOAT(RTB_STYLE_KEY_MAX_HEIGHT, max_size.h);
+	ASSIGN_LAYOUT_FLOAT(RTB_STYLE_KEY_FLEX_GROW, flex_grow);
+	ASSIGN_LAYOUT_FLOAT(RTB_STYLE_KEY_FLEX_SHRINK, flex_shrink);
+	ASSIGN_LAYOUT_FLOAT(RTB_STYLE_KEY_GAP, inner_pad.x);
+	ASSIGN_LAYOUT_FLOAT(RTB_STYLE_KEY_GAP, inner_pad.y);
 
 #undef ASSIGN_LAYOUT_FLOAT
 
-#define LOAD_PROP(name, type, member, load_func)                      \
-	if ((prop = rtb_style_query_prop(self, name, type, 0))            \
+#define LOAD_PROP(key, type, member, load_func)                       \
+	if ((prop = changed_prop(from, to, key, type))                    \
 			&& !load_func(&self->stylequad, &prop->member))           \
 
-#define LOAD_COLOR(name, load_func)                                   \
-		LOAD_PROP(name, RTB_STYLE_PROP_COLOR, color, load_func) {     \
+#define LOAD_COLOR(key, load_func)                                    \
+		LOAD_PROP(key, RTB_STYLE_PROP_COLOR, color, load_func) {      \
 			rtb_elem_mark_dirty(self);                                \
 		}
 
-#define LOAD_TEXTURE(name, load_func)                                 \
-		LOAD_PROP(name, RTB_STYLE_PROP_TEXTURE, texture, load_func) { \
+#define LOAD_TEXTURE(key, load_func)                                  \
+		LOAD_PROP(key, RTB_STYLE_PROP_TEXTURE, texture, load_func) {  \
 			rtb_elem_mark_dirty(self);                                \
 		}
 
-	LOAD_COLOR("background-color", rtb_stylequad_set_background_color);
-	LOAD_COLOR("border-color", rtb_stylequad_set_border_color);
+	old_bg_color = self->stylequad.properties.bg_color;
+
+	LOAD_COLOR(RTB_STYLE_KEY_BACKGROUND_COLOR,
+			rtb_stylequad_set_background_color);
+	LOAD_COLOR(RTB_STYLE_KEY_BORDER_COLOR,
+			rtb_stylequad_set_border_color);
 
-	LOAD_TEXTURE("border-image", rtb_stylequad_set_border_image);
-	LOAD_TEXTURE("background-image", rtb_stylequad_set_background_image);
+	LOAD_TEXTURE(RTB_STYLE_KEY_BORDER_IMAGE,
+			rtb_stylequad_set_border_image);
+	LOAD_TEXTURE(RTB_STYLE_KEY_BACKGROUND_IMAGE,
+			rtb_stylequad_set_background_image);
 
 #undef LOAD_TEXTURE
 #undef LOAD_COLOR
 #undef LOAD_PROP
 
+	/* our descendants might have just become (un)clearable. */
+	if (!old_bg_color != !self->stylequad.properties.bg_color)
+		TAILQ_FOREACH(iter, &self->children, child)
+			update_opaque_ancestors(iter);
+
 	if (need_reflow)
-		rtb_elem_reflow_rootward(self);
+		rtb_elem_request_reflow(self);
 }
 
 static void
@@ -306,8 +573,21 @@ restyle(struct rtb_element *self)
 
 	reload_style(self);
 
-	TAILQ_FOREACH(iter, &self->children, child)
+	/* the atlas is rebuilt whenever the window's style list is resolved
+	 * again, which can leave our resolved style the same. */
+	rtb_stylequad_resolve_atlas(&self->stylequad,
+			&self->window->style_atlas);
+
+	TAILQ_FOREACH(iter, &self->children, child) {
+		/* off-screen subtrees get restyled if and when they come back
+		 * into view, by update_visibility(). */
+		if (iter->visibility == RTB_FULLY_OBSCURED) {
+			iter->need_restyle = 1;
+			continue;
+		}
+
 		iter->restyle(iter);
+	}
 }
 
 /**
@@ -346,6 +626,8 @@ attached(struct rtb_element *self,
 	self->parent = parent;
 	self->window = window;
 
+	update_opaque_ancestor(self);
+
 	self->type = rtb_type_ref(window, NULL, "net.illest.rutabaga.element");
 
 	self->layout_cb(self);
@@ -376,6 +658,25 @@ child_detached(struct rtb_element *self, struct rtb_element *child)
 	child->detached(child, self, self->window);
 }
 
+/* takes `elem` and anything under it out of `surface`'s render queue.
+ * elements under a nested surface are queued on that surface instead,
+ * and go along with it. */
+static void
+unqueue_tree(struct rtb_surface *surface, struct rtb_element *elem)
+{
+	struct rtb_element *iter;
+
+	if (RTB_ELEMENT_IS_MARKED_DIRTY(elem)) {
+		TAILQ_REMOVE(&surface->render_queue, elem, render_entry);
+		elem->render_entry.tqe_next = NULL;
+		elem->render_entry.tqe_prev = NULL;
+	}
+
+	TAILQ_FOREACH(iter, &elem->children, child)
+		if (iter->surface == surface)
+			unqueue_tree(surface, iter);
+}
+
 static void
 mark_dirty(struct rtb_element *self)
 {
@@ -384,10 +685,21 @@ mark_dirty(struct rtb_element *self)
 	self = rtb_elem_nearest_clearable(self);
 
 	if (!surface || surface->surface_state == RTB_SURFACE_INVALID
-			|| self->render_entry.tqe_next || self->render_entry.tqe_prev)
+			|| RTB_ELEMENT_IS_MARKED_DIRTY(self))
 		return;
 
+	/* redrawing an element redraws its whole subtree, so there's no
+	 * point in queueing anything that an ancestor's redraw will cover.
+	 * descendants that were queued before us are left where they are
+	 * and skipped when the surface drains the queue, which saves
+	 * sweeping the whole queue on every mark. */
+	if (rtb_elem_has_queued_ancestor(self)) {
+		surface->window->frame_stats.coalesced_redraws++;
+		return;
+	}
+
 	TAILQ_INSERT_TAIL(&surface->render_queue, self, render_entry);
+	rtb_surface_damage(surface, &self->rect);
 	rtb_elem_mark_dirty(RTB_ELEMENT(surface));
 }
 
@@ -395,6 +707,21 @@ mark_dirty(struct rtb_element *self)
  * public API
  */
 
+int
+rtb_elem_has_queued_ancestor(struct rtb_element *self)
+{
+	struct rtb_element *surface = RTB_ELEMENT(self->surface);
+
+	while (self != surface) {
+		self = self->parent;
+
+		if (self != surface && RTB_ELEMENT_IS_MARKED_DIRTY(self))
+			return 1;
+	}
+
+	return 0;
+}
+
 int
 rtb_elem_deliver_event(struct rtb_element *self, const struct rtb_event *e)
 {
@@ -457,6 +784,7 @@ rtb_elem_draw(struct rtb_element *self, int clear_first)
 	if (clear_first)
 		rtb_render_clear(self);
 
+	self->window->frame_stats.elements_drawn++;
 	self->draw(self);
 	LAYOUT_DEBUG_DRAW_BOX(self);
 
@@ -466,35 +794,110 @@ rtb_elem_draw(struct rtb_element *self, int clear_first)
 int
 rtb_elem_is_clearable(struct rtb_element *self)
 {
-	struct rtb_surface *surface = self->surface;
-
-	/* XXX: shouldn't depend on stylequad like this */
-
-	for (self = self->parent;
-			self != RTB_ELEMENT(surface); self = self->parent)
-		if (self->stylequad.properties.bg_color)
-			return 0;
-
-	return 1;
+	return !self->opaque_ancestor;
 }
 
 struct rtb_element *
 rtb_elem_nearest_clearable(struct rtb_element *self)
 {
-	struct rtb_surface *surface = self->surface;
-
-	for (; self != RTB_ELEMENT(surface); self = self->parent)
-		if (rtb_elem_is_clearable(self))
-			return self;
+	/* the outermost opaque ancestor is clearable by definition, and
+	 * everything between it and us is not. */
+	if (self->opaque_ancestor)
+		return self->opaque_ancestor;
 
-	return RTB_ELEMENT(surface);
+	return self;
 }
 
+/* reflows trigger other reflows. only the outermost one gets timed,
+ * or we'd be counting the same work several times over. */
+static int reflow_depth = 0;
+
 void
 rtb_elem_trigger_reflow(struct rtb_element *self, struct rtb_element *instigator,
 		rtb_ev_direction_t direction)
 {
+	uint64_t start;
+
+	/* a rootward reflow means that `instigator` wants a different size
+	 * than it did, so its measurement and those of everything above it
+	 * are stale. */
+	if (direction == RTB_DIRECTION_ROOTWARD) {
+		if (instigator)
+			invalidate_layout(instigator);
+
+		if (!instigator || !rtb_elem_is_in_tree(self, instigator))
+			invalidate_layout(self);
+	}
+
+	if (reflow_depth++ || !self->window) {
+		self->reflow(self, instigator, direction);
+		reflow_depth--;
+		return;
+	}
+
+	start = uv_hrtime();
 	self->reflow(self, instigator, direction);
+	self->window->frame_stats.layout_ns += uv_hrtime() - start;
+	reflow_depth--;
+}
+
+void
+rtb_elem_update_visibility(struct rtb_element *self)
+{
+	struct rtb_element *iter;
+	struct rtb_rect clip;
+
+	if (is_window(self)) {
+		TAILQ_FOREACH(iter, &self->children, child)
+			rtb_elem_update_visibility(iter);
+		return;
+	}
+
+	surface_clip(self->surface, &clip);
+	update_tree_visibility(self, &clip);
+}
+
+void
+rtb_elem_request_reflow(struct rtb_element *self)
+{
+	invalidate_layout(self);
+}
+
+void
+rtb_elem_request_layout(struct rtb_element *self)
+{
+	/* our size is staying put, so measurements (ours and everybody
+	 * else's) are still good. */
+	for (; self; self = self->parent)
+		self->need_layout = 1;
+}
+
+void
+rtb_elem_flush_layout(struct rtb_element *self)
+{
+	struct rtb_element *root;
+	uint64_t start;
+
+	if (!self->window || self->window->state == RTB_STATE_UNATTACHED)
+		return;
+
+	root = RTB_ELEMENT(self->window);
+
+	/* anything marked has marked its ancestors too, so if the window
+	 * isn't marked then nothing is. */
+	if (!root->need_layout)
+		return;
+
+	if (reflow_depth++) {
+		layout_marked(root);
+		reflow_depth--;
+		return;
+	}
+
+	start = uv_hrtime();
+	layout_marked(root);
+	self->window->frame_stats.layout_ns += uv_hrtime() - start;
+	reflow_depth--;
 }
 
 void
@@ -515,16 +918,58 @@ rtb_elem_mark_dirty(struct rtb_element *self)
 	self->mark_dirty(self);
 }
 
+void
+rtb_elem_measure(struct rtb_element *self,
+		const struct rtb_size *avail, struct rtb_size *want)
+{
+	struct rtb_measurement *m;
+	int i;
+
+	if (self->need_measure) {
+		self->measure_cache.count = 0;
+		self->measure_cache.next  = 0;
+		self->need_measure = 0;
+	}
+
+	for (i = 0; i < self->measure_cache.count; i++) {
+		m = &self->measure_cache.entries[i];
+
+		if (m->avail.w == avail->w && m->avail.h == avail->h
+				&& m->size.w == self->w && m->size.h == self->h
+				&& m->min_size.w == self->min_size.w
+				&& m->min_size.h == self->min_size.h) {
+			*want = m->want;
+			return;
+		}
+	}
+
+	self->size_cb(self, avail, want);
+
+	m = &self->measure_cache.entries[self->measure_cache.next];
+	m->avail    = *avail;
+	m->size     = self->rect.size;
+	m->min_size = self->min_size;
+	m->want     = *want;
+
+	self->measure_cache.next =
+		(self->measure_cache.next + 1) % RTB_MEASURE_CACHE_SIZE;
+
+	if (self->measure_cache.count < RTB_MEASURE_CACHE_SIZE)
+		self->measure_cache.count++;
+}
+
 void
 rtb_elem_set_size_cb(struct rtb_element *self, rtb_elem_cb_size_t size_cb)
 {
 	self->size_cb = size_cb;
+	invalidate_layout(self);
 }
 
 void
 rtb_elem_set_layout(struct rtb_element *self, rtb_elem_cb_t layout_cb)
 {
 	self->layout_cb = layout_cb;
+	invalidate_layout(self);
 }
 
 void
@@ -580,13 +1025,19 @@ rtb_elem_add_child(struct rtb_element *self, struct rtb_element *child,
 	else
 		TAILQ_INSERT_TAIL(&self->children, child, child);
 
+	rtb_child_grid_invalidate(self);
+	invalidate_layout(child);
+	forget_layout(child);
+	reset_visibility(child);
+
 	if (self->window) {
 		self->child_attached(self, child);
 
+		/* adding a child doesn't change our own style, so only the
+		 * new subtree needs styling. restyling all of `self` here
+		 * would make building up a big container quadratic. */
 		if (self->window->state != RTB_STATE_UNATTACHED)
-			self->restyle(self);
-
-		self->reflow(self, child, RTB_DIRECTION_ROOTWARD);
+			child->restyle(child);
 	}
 }
 
@@ -594,8 +1045,11 @@ void
 rtb_elem_remove_child(struct rtb_element *self, struct rtb_element *child)
 {
 	TAILQ_REMOVE(&self->children, child, child);
+	rtb_child_grid_invalidate(self);
+	invalidate_layout(self);
 
-	/* XXX: remove from renderqueue if we're marked for redraw */
+	if (child->surface)
+		unqueue_tree(child->surface, child);
 
 	if (!self->window)
 		return;
@@ -620,8 +1074,13 @@ rtb_elem_remove_child(struct rtb_element *self, struct rtb_element *child)
 	child->parent = NULL;
 	child->style  = NULL;
 	child->state  = RTB_STATE_UNATTACHED;
+	child->resolved_style = NULL;
+
+	update_opaque_ancestors(child);
 
-	self->reflow(self, NULL, RTB_DIRECTION_LEAFWARD);
+	/* the space the child took up needs painting over even if none of
+	 * its siblings move into it. */
+	rtb_elem_mark_dirty(self);
 }
 
 static struct rtb_element_implementation base_impl = {
@@ -661,9 +1120,15 @@ rtb_elem_init(struct rtb_element *self)
 	self->inner_pad.x = RTB_DEFAULT_INNER_XPAD;
 	self->inner_pad.y = RTB_DEFAULT_INNER_YPAD;
 
+	self->flex_shrink = 1.f;
+
 	self->visibility  = RTB_UNOBSCURED;
 	self->window      = NULL;
 
+	self->need_measure = 1;
+	self->need_layout  = 1;
+	forget_layout(self);
+
 	VECTOR_INIT(&self->handlers, &stdlib_allocator, 1);
 
 	rtb_stylequad_init(&self->stylequad);
@@ -677,6 +1142,7 @@ void
 rtb_elem_fini(struct rtb_element *self)
 {
 	rtb_stylequad_fini(&self->stylequad);
+	rtb_child_grid_free(self);
 	VECTOR_FREE(&self->handlers);
 	rtb_type_unref(self->type);
 }
@@ -32,41 +32,61 @@
 #include "rutabaga/event.h"
 #include "rutabaga/element.h"
 
-static const struct rtb_event_handler *
-find_handler_for(struct rtb_element *elem, rtb_ev_type_t type)
+/* each element keeps a 64-bit mask of the event types it has handlers
+ * for. system events get the top half and everything else the bottom,
+ * indexed by the low bits of the type. types can share a bit, so a set
+ * bit only means "maybe", but a clear one means "definitely not". */
+static uint64_t
+type_bit(rtb_ev_type_t type)
 {
-	struct rtb_event_handler *handlers;
-	int i, size;
+	unsigned int bit = type & 31;
 
-	handlers = elem->handlers.data;
-	size = elem->handlers.size;
+	if (RTB_IS_SYS_EVENT(type))
+		bit += 32;
 
-	for (i = 0; i < size; i++)
-		if (handlers[i].type == type)
-			return &handlers[i];
+	return UINT64_C(1) << bit;
+}
+
+static void
+update_handler_mask(struct rtb_element *elem)
+{
+	size_t i;
 
-	return NULL;
+	elem->handler_mask = 0;
+
+	for (i = 0; i < elem->handlers.size; i++)
+		elem->handler_mask |= type_bit(elem->handlers.data[i].type);
 }
 
-static int
-replace_handler(struct rtb_element *elem, struct rtb_event_handler *with)
+/* index of the first handler for `type`, or of where one would go. */
+static size_t
+first_handler_for(struct rtb_element *elem, rtb_ev_type_t type)
 {
-	struct rtb_event_handler *handlers;
-	int i, size;
-
-	handlers = elem->handlers.data;
-	size = elem->handlers.size;
-
-	for (i = 0; i < size; i++) {
-		/* if there's already a handler defined for this event type,
-		 * replace it. */
-		if (handlers[i].type == with->type) {
-			handlers[i] = *with;
-			return 1;
-		}
+	struct rtb_event_handler *handlers = elem->handlers.data;
+	size_t lo, hi, mid;
+
+	lo = 0;
+	hi = elem->handlers.size;
+
+	while (lo < hi) {
+		mid = lo + ((hi - lo) / 2);
+
+		if (handlers[mid].type < type)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
 
-	return 0;
+	return lo;
+}
+
+static size_t
+end_of_handlers_for(struct rtb_element *elem, rtb_ev_type_t type, size_t i)
+{
+	while (i < elem->handlers.size && elem->handlers.data[i].type == type)
+		i++;
+
+	return i;
 }
 
 /**
@@ -76,12 +96,29 @@ replace_handler(struct rtb_element *elem, struct rtb_event_handler *with)
 int
 rtb_handle(struct rtb_element *target, const struct rtb_event *event)
 {
-	const struct rtb_event_handler *h;
+	size_t i, first, count;
+
+	if (!(target->handler_mask & type_bit(event->type)))
+		return 0;
+
+	first = first_handler_for(target, event->type);
+	count = end_of_handlers_for(target, event->type, first) - first;
 
-	if (!(h = find_handler_for(target, event->type)))
+	if (!count)
 		return 0;
 
-	h->callback.cb(target, event, h->callback.ctx);
+	{
+		/* handlers can add and remove handlers, so call a copy of the
+		 * list as it was when the event arrived. any changes take
+		 * effect from the next event on. */
+		struct rtb_event_handler snapshot[count];
+
+		memcpy(snapshot, target->handlers.data + first, sizeof(snapshot));
+
+		for (i = 0; i < count; i++)
+			snapshot[i].callback.cb(target, event, snapshot[i].callback.ctx);
+	}
+
 	return 1;
 }
 
@@ -107,36 +144,71 @@ rtb_dispatch_simple(struct rtb_element *target, rtb_ev_type_t type)
 int
 rtb_register_handler(struct rtb_element *target, rtb_ev_type_t type,
 		rtb_event_cb_t cb, void *user_arg)
+{
+	assert(target);
+	assert(cb);
+
+	rtb_unregister_handler(target, type);
+	return rtb_add_handler(target, type, cb, user_arg);
+}
+
+void
+rtb_unregister_handler(struct rtb_element *target, rtb_ev_type_t type)
+{
+	size_t first, last;
+
+	assert(target);
+
+	first = first_handler_for(target, type);
+	last  = end_of_handlers_for(target, type, first);
+
+	if (first == last)
+		return;
+
+	VECTOR_ERASE_RANGE(&target->handlers, first, last);
+	update_handler_mask(target);
+}
+
+int
+rtb_add_handler(struct rtb_element *target, rtb_ev_type_t type,
+		rtb_event_cb_t cb, void *user_arg)
 {
 	struct rtb_event_handler handler = {
 		.type         = type,
 		.callback.cb  = cb,
 		.callback.ctx = user_arg
 	};
+	size_t at;
 
 	assert(target);
 	assert(cb);
 
-	if (!replace_handler(target, &handler))
-		VECTOR_PUSH_BACK(&target->handlers, &handler);
+	at = end_of_handlers_for(target, type, first_handler_for(target, type));
+	VECTOR_INSERT(&target->handlers, at, &handler);
 
+	target->handler_mask |= type_bit(type);
 	return 0;
 }
 
 void
-rtb_unregister_handler(struct rtb_element *target, rtb_ev_type_t type)
+rtb_remove_handler(struct rtb_element *target, rtb_ev_type_t type,
+		rtb_event_cb_t cb, void *user_arg)
 {
 	const struct rtb_event_handler *handlers;
-	int i, size;
+	size_t i, last;
 
 	assert(target);
 
+	i    = first_handler_for(target, type);
+	last = end_of_handlers_for(target, type, i);
+
 	handlers = target->handlers.data;
-	size = target->handlers.size;
 
-	for (i = 0; i < size; i++) {
-		if (handlers[i].type == type) {
+	for (; i < last; i++) {
+		if (handlers[i].callback.cb == cb
+				&& handlers[i].callback.ctx == user_arg) {
 			VECTOR_ERASE(&target->handlers, i);
+			update_handler_mask(target);
 			return;
 		}
 	}
@@ -54,7 +54,7 @@ rtb_size_hfit_children(struct rtb_element *elem,
 	struct rtb_size child, need = {-elem->inner_pad.x, 0.f}, zero = {0.f, 0.f};
 
 	TAILQ_FOREACH(iter, &elem->children, child) {
-		iter->size_cb(iter, &zero, &child);
+		rtb_elem_measure(iter, &zero, &child);
 
 		need.w += child.w + elem->inner_pad.x;
 		need.h  = fmax(need.h, child.h);
@@ -75,7 +75,7 @@ rtb_size_vfit_children(struct rtb_element *elem,
 	struct rtb_size child, need = {0.f, -elem->inner_pad.y}, zero = {0.f, 0.f};
 
 	TAILQ_FOREACH(iter, &elem->children, child) {
-		iter->size_cb(iter, &zero, &child);
+		rtb_elem_measure(iter, &zero, &child);
 
 		need.w  = fmax(need.w, child.w);
 		need.h += child.h + elem->inner_pad.y;
@@ -125,7 +125,7 @@ rtb_layout_unmanaged(struct rtb_element *elem)
 	avail = elem->inner_rect.size;
 
 	TAILQ_FOREACH(iter, &elem->children, child) {
-		iter->size_cb(iter, &avail, &child);
+		rtb_elem_measure(iter, &avail, &child);
 		rtb_elem_set_size(iter, &child);
 	}
 }
@@ -147,14 +147,15 @@ rtb_layout_vpack_top(struct rtb_element *elem)
 	position.y = elem->inner_rect.y;
 
 	TAILQ_FOREACH(iter, &elem->children, child) {
-		iter->size_cb(iter, &avail, &child);
+		rtb_elem_measure(iter, &avail, &child);
 		position.x = xstart + halign(avail.w, child.w, iter->align);
 
 		rtb_elem_set_position_from_point(iter, &position);
 		rtb_elem_set_size(iter, &child);
 
 		/* XXX: what if a child in the middle wants all the space,
-		 *      and there are still children left to layout? */
+		 *      and there are still children left to layout?
+		 *      (use rtb_layout_vflex() and flex-grow for that) */
 		avail.h    -= child.h + elem->inner_pad.y;
 		position.y += child.h + elem->inner_pad.y;
 	}
@@ -174,7 +175,7 @@ rtb_layout_vpack_middle(struct rtb_element *elem)
 
 	children_height = -elem->inner_pad.y;
 	TAILQ_FOREACH(iter, &elem->children, child) {
-		iter->size_cb(iter, &avail, &child);
+		rtb_elem_measure(iter, &avail, &child);
 		children_height += child.h + elem->inner_pad.y;
 	}
 
@@ -184,7 +185,7 @@ rtb_layout_vpack_middle(struct rtb_element *elem)
 		return rtb_layout_vpack_top(elem);
 
 	TAILQ_FOREACH(iter, &elem->children, child) {
-		iter->size_cb(iter, &avail, &child);
+		rtb_elem_measure(iter, &avail, &child);
 		position.x = xstart + halign(avail.w, child.w, iter->align);
 
 		rtb_elem_set_position_from_point(iter, &position);
@@ -209,7 +210,7 @@ rtb_layout_vpack_bottom(struct rtb_element *elem)
 	position.y = elem->inner_rect.y2 + elem->inner_pad.y;
 
 	TAILQ_FOREACH_REVERSE(iter, &elem->children, children, child) {
-		iter->size_cb(iter, &avail, &child);
+		rtb_elem_measure(iter, &avail, &child);
 		position.x = xstart + halign(avail.w, child.w, iter->align);
 		position.y -= child.h + elem->inner_pad.y;
 
@@ -240,7 +241,7 @@ rtb_layout_hpack_left(struct rtb_element *elem)
 	ystart = elem->inner_rect.y;
 
 	TAILQ_FOREACH(iter, &elem->children, child) {
-		iter->size_cb(iter, &avail, &child);
+		rtb_elem_measure(iter, &avail, &child);
 		position.y = ystart + valign(avail.h, child.h, iter->align);
 
 		rtb_elem_set_position_from_point(iter, &position);
@@ -265,7 +266,7 @@ rtb_layout_hpack_center(struct rtb_element *elem)
 
 	children_width = -elem->inner_pad.x;
 	TAILQ_FOREACH(iter, &elem->children, child) {
-		iter->size_cb(iter, &avail, &child);
+		rtb_elem_measure(iter, &avail, &child);
 		children_width += child.w + elem->inner_pad.x;
 	}
 
@@ -275,7 +276,7 @@ rtb_layout_hpack_center(struct rtb_element *elem)
 		return rtb_layout_hpack_left(elem);
 
 	TAILQ_FOREACH(iter, &elem->children, child) {
-		iter->size_cb(iter, &avail, &child);
+		rtb_elem_measure(iter, &avail, &child);
 		position.y = ystart + valign(avail.h, child.h, iter->align);
 
 		rtb_elem_set_position_from_point(iter, &position);
@@ -299,7 +300,7 @@ rtb_layout_hpack_right(struct rtb_element *elem)
 	ystart = elem->inner_rect.y;
 
 	TAILQ_FOREACH_REVERSE(iter, &elem->children, children, child) {
-		iter->size_cb(iter, &avail, &child);
+		rtb_elem_measure(iter, &avail, &child);
 		position.x -= child.w + elem->inner_pad.x;
 		position.y = ystart + valign(avail.h, child.h, iter->align);
 
@@ -381,7 +382,7 @@ rtb_layout_hdistribute(struct rtb_element *elem)
 	avail = elem->inner_rect.size;
 
 	TAILQ_FOREACH(iter, &elem->children, child) {
-		iter->size_cb(iter, &avail, &child);
+		rtb_elem_measure(iter, &avail, &child);
 		rtb_elem_set_size(iter, &child);
 
 		if (!child0_width)
@@ -403,3 +404,200 @@ rtb_layout_hdistribute(struct rtb_element *elem)
 		return hdistribute_many(elem, children, child0_width, children_width);
 	}
 }
+
+/**
+ * flex
+ *
+ * packs children along one axis like hpack_left/vpack_top, then hands
+ * out whatever space is left over (or missing) in proportion to their
+ * flex-grow (or flex-shrink times their size), keeping everybody
+ * between their min and max size. a child that hits one of those is
+ * frozen there and the rest is shared out again amongst the others,
+ * so this goes round at most once per child.
+ */
+
+struct flex_item {
+	struct rtb_element *elem;
+	struct rtb_size want;
+
+	float min, max;
+	float base, size;
+	float factor;
+	int frozen;
+};
+
+static inline float
+main_axis(const struct rtb_size *s, int vertical)
+{
+	return vertical ? s->h : s->w;
+}
+
+static inline float
+cross_axis(const struct rtb_size *s, int vertical)
+{
+	return vertical ? s->w : s->h;
+}
+
+/* 0 in max_size is "no maximum". */
+static inline float
+clamp_size(float size, float min, float max)
+{
+	if (max > 0.f && size > max)
+		size = max;
+
+	return fmax(size, min);
+}
+
+static void
+flex_resolve(struct flex_item *items, int count, float space)
+{
+	float free_space, factors, target, violation;
+	int i, growing;
+
+	free_space = space;
+	for (i = 0; i < count; i++)
+		free_space -= items[i].base;
+
+	growing = free_space > 0.f;
+
+	for (i = 0; i < count; i++) {
+		items[i].size = items[i].base;
+		items[i].factor = growing
+			? items[i].elem->flex_grow
+			: items[i].elem->flex_shrink * items[i].base;
+
+		items[i].frozen = items[i].factor <= 0.f
+			|| (growing && items[i].max > 0.f
+				&& items[i].base >= items[i].max)
+			|| (!growing && items[i].base <= items[i].min);
+	}
+
+	for (;;) {
+		free_space = space;
+		factors = 0.f;
+
+		for (i = 0; i < count; i++) {
+			if (items[i].frozen) {
+				free_space -= items[i].size;
+			} else {
+				free_space -= items[i].base;
+				factors += items[i].factor;
+			}
+		}
+
+		if (factors <= 0.f)
+			return;
+
+		violation = 0.f;
+
+		for (i = 0; i < count; i++) {
+			if (items[i].frozen)
+				continue;
+
+			target = items[i].base
+				+ free_space * (items[i].factor / factors);
+			items[i].size = clamp_size(target, items[i].min, items[i].max);
+			violation += items[i].size - target;
+		}
+
+		if (violation == 0.f)
+			return;
+
+		/* clamped items made room (or ate into it), so freeze the
+		 * ones that were clamped in the direction of the overall
+		 * violation and go again with the rest. */
+		for (i = 0; i < count; i++) {
+			if (items[i].frozen)
+				continue;
+
+			target = items[i].base
+				+ free_space * (items[i].factor / factors);
+
+			if ((violation > 0.f && items[i].size > target)
+					|| (violation < 0.f && items[i].size < target))
+				items[i].frozen = 1;
+		}
+	}
+}
+
+static void
+flex(struct rtb_element *elem, int vertical)
+{
+	float space, gap, cross_avail, cross, offset;
+	struct rtb_size avail, child;
+	struct rtb_point position;
+	struct rtb_element *iter;
+	int i, count;
+
+	count = 0;
+	TAILQ_FOREACH(iter, &elem->children, child)
+		count++;
+
+	if (!count)
+		return;
+
+	struct flex_item items[count];
+
+	avail = elem->inner_rect.size;
+	gap = vertical ? elem->inner_pad.y : elem->inner_pad.x;
+	space = main_axis(&avail, vertical) - (gap * (count - 1));
+	cross_avail = cross_axis(&avail, vertical);
+
+	i = 0;
+	TAILQ_FOREACH(iter, &elem->children, child) {
+		items[i].elem = iter;
+		rtb_elem_measure(iter, &avail, &items[i].want);
+
+		items[i].min  = main_axis(&iter->min_size, vertical);
+		items[i].max  = main_axis(&iter->max_size, vertical);
+		items[i].base = clamp_size(main_axis(&items[i].want, vertical),
+				items[i].min, items[i].max);
+		i++;
+	}
+
+	flex_resolve(items, count, space);
+
+	position.x = elem->inner_rect.x;
+	position.y = elem->inner_rect.y;
+
+	for (i = 0; i < count; i++) {
+		iter = items[i].elem;
+		cross = clamp_size(cross_axis(&items[i].want, vertical),
+				cross_axis(&iter->min_size, vertical),
+				cross_axis(&iter->max_size, vertical));
+
+		if (vertical) {
+			child.w = cross;
+			child.h = items[i].size;
+
+			offset = halign(cross_avail, child.w, iter->align);
+			position.x = elem->inner_rect.x + offset;
+		} else {
+			child.w = items[i].size;
+			child.h = cross;
+
+			offset = valign(cross_avail, child.h, iter->align);
+			position.y = elem->inner_rect.y + offset;
+		}
+
+		rtb_elem_set_position_from_point(iter, &position);
+		rtb_elem_set_size(iter, &child);
+
+		if (vertical)
+			position.y += child.h + gap;
+		else
+			position.x += child.w + gap;
+	}
+}
+
+void
+rtb_layout_hflex(struct rtb_element *elem)
+{
+	flex(elem, 0);
+}
+
+void
+rtb_layout_vflex(struct rtb_element *elem)
+{
+	flex(elem, 1);
+}
@@ -542,6 +542,8 @@ rtb_cocoa_draw_frame(struct cocoa_rtb_window *self, int force)
 
 		rtb_window_lock(win);
 
+		rtb__platform_mouse_flush_motion(win);
+
 		if (rtb_window_draw(win, force))
 			[self->gl_ctx flushBuffer];
 
@@ -0,0 +1,111 @@
+/**
+ * rutabaga: an OpenGL widget toolkit
+ * Copyright (c) 2013 William Light.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <uv.h>
+
+#include <rutabaga/opengl.h>
+
+#include <rutabaga/rutabaga.h>
+#include <rutabaga/window.h>
+#include <rutabaga/keyboard.h>
+#include <rutabaga/platform.h>
+
+#include "rtb_private/util.h"
+
+#include "headless_rtb.h"
+
+/**
+ * keyboard
+ */
+
+rtb_modkey_t
+rtb_get_modkeys(struct rtb_window *win)
+{
+	/* no keyboard, no modifiers. */
+	return 0;
+}
+
+/**
+ * event loop
+ */
+
+/* with no display to sync to, frames are drawn back to back, once per
+ * turn of the loop. */
+static void
+frame_cb(uv_idle_t *_handle)
+{
+	struct headless_frame_idler *idler;
+	struct rtb_window *win;
+
+	idler = RTB_DOWNCAST(_handle, headless_frame_idler, uv_idle_s);
+	win = RTB_WINDOW(idler->hwin);
+
+	rtb_window_lock(win);
+
+	if (win->need_reconfigure) {
+		rtb_window_reinit(win);
+		win->need_reconfigure = 0;
+	}
+
+	rtb__platform_mouse_flush_motion(win);
+
+	if (rtb_window_draw(win, 0))
+		glFlush();
+
+	rtb_window_unlock(win);
+}
+
+void
+rtb_event_loop_init(struct rutabaga *r)
+{
+	struct headless_rutabaga *hrtb = (void *) r;
+	struct headless_window *hwin = (void *) r->win;
+
+	hrtb->frame_idler.hwin = hwin;
+	uv_idle_init(&r->event_loop, RTB_UPCAST(&hrtb->frame_idler, uv_idle_s));
+	uv_idle_start(RTB_UPCAST(&hrtb->frame_idler, uv_idle_s), frame_cb);
+}
+
+void
+rtb_event_loop_run(struct rutabaga *r)
+{
+	uv_run(&r->event_loop, UV_RUN_DEFAULT);
+}
+
+void
+rtb_event_loop_stop(struct rutabaga *r)
+{
+	uv_stop(&r->event_loop);
+}
+
+void
+rtb_event_loop_fini(struct rutabaga *r)
+{
+	struct headless_rutabaga *hrtb = (void *) r;
+
+	uv_close((void *) RTB_UPCAST(&hrtb->frame_idler, uv_idle_s), NULL);
+	uv_run(&r->event_loop, UV_RUN_NOWAIT);
+}
@@ -0,0 +1,61 @@
+/**
+ * rutabaga: an OpenGL widget toolkit
+ * Copyright (c) 2013 William Light.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "rutabaga/rutabaga.h"
+#include "rutabaga/window.h"
+
+#include <uv.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#define ERR(...) fprintf(stderr, "rutabaga headless: " __VA_ARGS__)
+
+struct headless_frame_idler {
+	RTB_INHERIT(uv_idle_s);
+	struct headless_window *hwin;
+};
+
+struct headless_rutabaga {
+	struct rutabaga rtb;
+
+	EGLDisplay dpy;
+
+	struct headless_frame_idler frame_idler;
+};
+
+struct headless_window {
+	RTB_INHERIT(rtb_window);
+
+	struct headless_rutabaga *hrtb;
+
+	EGLContext gl_ctx;
+
+	/* there's no window system framebuffer to draw into, so we render
+	 * into one of our own. it's bound whenever the window is locked. */
+	GLuint offscreen_fbo;
+	GLuint offscreen_rb;
+};
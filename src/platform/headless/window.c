@@ -0,0 +1,268 @@
+/**
+ * rutabaga: an OpenGL widget toolkit
+ * Copyright (c) 2013 William Light.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * headless platform: renders through a surfaceless EGL context into an
+ * offscreen framebuffer, so that rutabaga can run (and be benchmarked or
+ * pixel-tested) on machines without a display server or a GPU.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <uv.h>
+
+#include <rutabaga/opengl.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <rutabaga/rutabaga.h>
+#include <rutabaga/window.h>
+
+#include "rtb_private/window_impl.h"
+#include "rtb_private/util.h"
+
+#include "headless_rtb.h"
+
+/* there's no screen to ask, so we pick something fixed. this keeps text
+ * rendering identical from one machine to the next. */
+#ifndef HEADLESS_DPI
+#define HEADLESS_DPI 96
+#endif
+
+static EGLDisplay
+get_display(void)
+{
+	PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display;
+	const char *extensions;
+
+	extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	get_platform_display = (void *)
+		eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+	if (extensions && get_platform_display
+			&& strstr(extensions, "EGL_MESA_platform_surfaceless"))
+		return get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+				EGL_DEFAULT_DISPLAY, NULL);
+
+	return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+struct rutabaga *
+window_impl_rtb_alloc(void)
+{
+	struct headless_rutabaga *self;
+
+	if (!(self = calloc(1, sizeof(*self))))
+		goto err_malloc;
+
+	if ((self->dpy = get_display()) == EGL_NO_DISPLAY) {
+		ERR("can't get an EGL display\n");
+		goto err_dpy;
+	}
+
+	if (!eglInitialize(self->dpy, NULL, NULL)) {
+		ERR("can't initialize EGL\n");
+		goto err_dpy;
+	}
+
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		ERR("EGL implementation doesn't support desktop GL\n");
+		goto err_bind_api;
+	}
+
+	return (struct rutabaga *) self;
+
+err_bind_api:
+	eglTerminate(self->dpy);
+err_dpy:
+	free(self);
+err_malloc:
+	return NULL;
+}
+
+void
+window_impl_rtb_free(struct rutabaga *rtb)
+{
+	struct headless_rutabaga *self = (void *) rtb;
+
+	eglTerminate(self->dpy);
+	free(self);
+}
+
+static EGLContext
+new_gl_context(EGLDisplay dpy)
+{
+	const EGLint attribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 2,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK,
+			EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+
+	/* we never draw to an EGL surface, so there's no config to match. */
+	return eglCreateContext(dpy, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attribs);
+}
+
+static int
+framebuffer_init(struct headless_window *self, int w, int h)
+{
+	GLenum status;
+
+	glGenRenderbuffers(1, &self->offscreen_rb);
+	glBindRenderbuffer(GL_RENDERBUFFER, self->offscreen_rb);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, w, h);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &self->offscreen_fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, self->offscreen_fbo);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			GL_RENDERBUFFER, self->offscreen_rb);
+
+	status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteFramebuffers(1, &self->offscreen_fbo);
+		glDeleteRenderbuffers(1, &self->offscreen_rb);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void
+framebuffer_fini(struct headless_window *self)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &self->offscreen_fbo);
+	glDeleteRenderbuffers(1, &self->offscreen_rb);
+}
+
+struct rtb_window *
+window_impl_open(struct rutabaga *rtb,
+		int w, int h, const char *title, intptr_t parent)
+{
+	struct headless_rutabaga *hrtb = (void *) rtb;
+	struct headless_window *self;
+
+	assert(rtb);
+	assert(h > 0);
+	assert(w > 0);
+
+	if (!(self = calloc(1, sizeof(*self))))
+		goto err_malloc;
+
+	self->hrtb = hrtb;
+
+	self->gl_ctx = new_gl_context(hrtb->dpy);
+	if (!self->gl_ctx) {
+		ERR("couldn't create GL context\n");
+		goto err_gl_ctx;
+	}
+
+	if (!eglMakeCurrent(hrtb->dpy,
+				EGL_NO_SURFACE, EGL_NO_SURFACE, self->gl_ctx)) {
+		ERR("couldn't activate GL context\n");
+		goto err_make_current;
+	}
+
+	/* the GL entry points have to be loaded before we can make the
+	 * framebuffer, and rtb_window_open() hasn't gotten to that yet. */
+	if (ogl_LoadFunctions() == ogl_LOAD_FAILED) {
+		ERR("couldn't load GL functions\n");
+		goto err_load_functions;
+	}
+
+	if (framebuffer_init(self, w, h)) {
+		ERR("couldn't create offscreen framebuffer\n");
+		goto err_framebuffer;
+	}
+
+	self->dpi.x = HEADLESS_DPI;
+	self->dpi.y = HEADLESS_DPI;
+
+	/* the framebuffer is ours and nothing else draws into it, so what
+	 * we drew last frame is always still there. */
+	self->buffer_age = 1;
+
+	/* nothing is going to tell us that we've been mapped, so we'll get
+	 * set up as soon as the event loop starts. */
+	self->need_reconfigure = 1;
+
+	uv_mutex_init(&self->lock);
+	return RTB_WINDOW(self);
+
+err_framebuffer:
+err_load_functions:
+	eglMakeCurrent(hrtb->dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+err_make_current:
+	eglDestroyContext(hrtb->dpy, self->gl_ctx);
+err_gl_ctx:
+	free(self);
+err_malloc:
+	return NULL;
+}
+
+void
+window_impl_close(struct rtb_window *rwin)
+{
+	struct headless_window *self = RTB_WINDOW_AS(rwin, headless_window);
+	EGLDisplay dpy = self->hrtb->dpy;
+
+	framebuffer_fini(self);
+
+	eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(dpy, self->gl_ctx);
+
+	uv_mutex_unlock(&self->lock);
+	uv_mutex_destroy(&self->lock);
+
+	free(self);
+}
+
+void
+rtb_window_lock(struct rtb_window *rwin)
+{
+	struct headless_window *self = RTB_WINDOW_AS(rwin, headless_window);
+
+	uv_mutex_lock(&self->lock);
+	eglMakeCurrent(self->hrtb->dpy,
+			EGL_NO_SURFACE, EGL_NO_SURFACE, self->gl_ctx);
+	glBindFramebuffer(GL_FRAMEBUFFER, self->offscreen_fbo);
+}
+
+void
+rtb_window_unlock(struct rtb_window *rwin)
+{
+	struct headless_window *self = RTB_WINDOW_AS(rwin, headless_window);
+
+	eglMakeCurrent(self->hrtb->dpy,
+			EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	uv_mutex_unlock(&self->lock);
+}
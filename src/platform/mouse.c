@@ -24,14 +24,18 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <string.h>
 #include <uv.h>
 
 #include "rutabaga/rutabaga.h"
 #include "rutabaga/window.h"
+#include "rutabaga/surface.h"
 #include "rutabaga/event.h"
 #include "rutabaga/mouse.h"
 #include "rutabaga/platform.h"
 
+#include "rtb_private/child-grid.h"
+
 /**
  * event dispatching
  */
@@ -272,13 +276,25 @@ element_underneath_mouse(struct rtb_window *win)
 	return RTB_ELEMENT(win);
 }
 
+/* rects are in the content coordinates of whichever surface an element
+ * is drawn into, and that surface may have been scrolled. */
+static struct rtb_point
+cursor_for(struct rtb_element *elem, int x, int y)
+{
+	struct rtb_point cursor = {x, y};
+
+	rtb_surface_to_content(elem->surface, &cursor);
+	return cursor;
+}
+
 static void
 retarget(struct rtb_window *win, int x, int y)
 {
 	struct rtb_element *iter, *ret = element_underneath_mouse(win);
-	struct rtb_point cursor = {x, y};
+	struct rtb_point cursor;
 
 	while (ret != (struct rtb_element *) win) {
+		cursor = cursor_for(ret, x, y);
 		if (RTB_POINT_IN_RECT(cursor, *ret))
 			break;
 
@@ -291,24 +307,113 @@ retarget(struct rtb_window *win, int x, int y)
 		ret = ret->parent;
 	}
 
-descend:
-	TAILQ_FOREACH_REVERSE(iter, &ret->children, children, child) {
-		if (RTB_POINT_IN_RECT(cursor, *iter)) {
-			ret = iter;
-			ret->mouse_in = 1;
+	while ((iter = TAILQ_FIRST(&ret->children))) {
+		cursor = cursor_for(iter, x, y);
+		if (!(iter = rtb_child_grid_hit(ret, &cursor)))
+			break;
 
-			dispatch_simple_mouse_event(win, ret, RTB_MOUSE_ENTER, -1, x, y);
+		ret = iter;
+		ret->mouse_in = 1;
 
-			if (win->mouse.buttons_down)
-				dispatch_drag_enter(win, ret, x, y);
+		dispatch_simple_mouse_event(win, ret, RTB_MOUSE_ENTER, -1, x, y);
 
-			goto descend;
-		}
+		if (win->mouse.buttons_down)
+			dispatch_drag_enter(win, ret, x, y);
 	}
 
 	win->mouse.element_underneath = ret;
 }
 
+static void
+record_motion(struct rtb_mouse *mouse, int x, int y)
+{
+	struct rtb_mouse_motion *sample;
+
+	/* a new motion starts a new history, unless we're still collecting
+	 * samples for one that hasn't gone out yet. */
+	if (!mouse->motion_pending)
+		mouse->history.count = 0;
+	else if (mouse->history.count == RTB_MOUSE_MOTION_HISTORY) {
+		memmove(mouse->history.samples, mouse->history.samples + 1,
+				sizeof(*sample) * (RTB_MOUSE_MOTION_HISTORY - 1));
+		mouse->history.count--;
+	}
+
+	sample = &mouse->history.samples[mouse->history.count++];
+	sample->x = x;
+	sample->y = y;
+	sample->timestamp = uv_hrtime();
+}
+
+static void motion(struct rtb_window *, int x, int y);
+
+static void
+leave_window(struct rtb_window *win, int x, int y)
+{
+	struct rtb_element *underneath = element_underneath_mouse(win);
+
+	while (underneath) {
+		underneath->mouse_in = 0;
+		dispatch_simple_mouse_event(
+				win, underneath, RTB_MOUSE_LEAVE, -1, x, y);
+
+		if (win->mouse.buttons_down)
+			dispatch_drag_leave(win, underneath, x, y);
+
+		underneath = underneath->parent;
+	}
+
+	win->mouse.element_underneath = NULL;
+	win->mouse_in = 0;
+}
+
+static void
+enter_window(struct rtb_window *win, int x, int y)
+{
+	if (win->mouse_in)
+		leave_window(win, x, y);
+
+	win->mouse_in = 1;
+	win->mouse.element_underneath = RTB_ELEMENT(win);
+
+	dispatch_simple_mouse_event(win, RTB_ELEMENT(win),
+			RTB_MOUSE_ENTER, -1, x, y);
+
+	/* XXX: only on x11-xcb? */
+	motion(win, x, y);
+}
+
+static void
+motion(struct rtb_window *win, int x, int y)
+{
+	struct rtb_size delta;
+
+	if (!win->mouse_in) {
+		if ((0 < x && x < win->w) && (0 < y && y < win->h)) {
+			enter_window(win, x, y);
+			return;
+		} else if (!win->mouse.buttons_down)
+			return;
+	}
+
+	retarget(win, x, y);
+
+	win->mouse.x = x;
+	win->mouse.y = y;
+
+	if (win->mouse.buttons_down) {
+		delta.w = x - win->mouse.previous.x;
+		delta.h = y - win->mouse.previous.y;
+
+		/* the positioning of this line is VERY important. see
+		 * platform/x11-xcb/cursor.c function rtb_mouse_pointer_warp() */
+		win->mouse.previous = *RTB_UPCAST(&win->mouse, rtb_point);
+
+		drag(win, x, y, delta);
+	} else
+		win->mouse.previous = *RTB_UPCAST(&win->mouse, rtb_point);
+}
+
 /**
  * platform API
  */
@@ -319,6 +424,8 @@ rtb__platform_mouse_press(struct rtb_window *win,
 {
 	struct rtb_element *target;
 
+	rtb__platform_mouse_flush_motion(win);
+
 	if (button > RTB_MOUSE_BUTTON_MAX)
 		return;
 
@@ -340,6 +447,8 @@ rtb__platform_mouse_release(struct rtb_window *win,
 {
 	struct rtb_element *target;
 
+	rtb__platform_mouse_flush_motion(win);
+
 	if (button > RTB_MOUSE_BUTTON_MAX)
 		return;
 
@@ -352,42 +461,39 @@ rtb__platform_mouse_release(struct rtb_window *win,
 void
 rtb__platform_mouse_motion(struct rtb_window *win, int x, int y)
 {
-	struct rtb_size delta;
+	record_motion(&win->mouse, x, y);
 
-	if (!win->mouse_in) {
-		if ((0 < x && x < win->w) && (0 < y && y < win->h)) {
-			rtb__platform_mouse_enter_window(win, x, y);
-			return;
-		} else if (!win->mouse.buttons_down)
-			return;
-	}
+	if (win->mouse.coalesce_motion) {
+		if (win->mouse.motion_pending)
+			win->frame_stats.coalesced_motions++;
 
-	retarget(win, x, y);
+		win->mouse.motion_pending = 1;
+		return;
+	}
 
-	win->mouse.x = x;
-	win->mouse.y = y;
+	motion(win, x, y);
+}
 
-	if (win->mouse.buttons_down) {
-		delta.w = x - win->mouse.previous.x;
-		delta.h = y - win->mouse.previous.y;
+void
+rtb__platform_mouse_flush_motion(struct rtb_window *win)
+{
+	struct rtb_mouse_motion *last;
 
-		/* the positioning of this line is VERY important. see
-		 * platform/x11-xcb/cursor.c function rtb_mouse_pointer_warp() */
-		win->mouse.previous = *RTB_UPCAST(&win->mouse, rtb_point);
+	if (!win->mouse.motion_pending)
+		return;
 
-		drag(win, x, y, delta);
-	} else
-		win->mouse.previous = *RTB_UPCAST(&win->mouse, rtb_point);
+	win->mouse.motion_pending = 0;
+	last = &win->mouse.history.samples[win->mouse.history.count - 1];
+	motion(win, last->x, last->y);
 }
 
 void
 rtb__platform_mouse_wheel(struct rtb_window *window, int x, int y, float delta)
 {
-	struct rtb_element *target = element_underneath_mouse(window);
+	struct rtb_element *target;
 	struct rtb_mouse_event ev = {
 		.type = RTB_MOUSE_WHEEL,
 		.window = window,
-		.target = target,
 
 		.mod_keys = rtb_get_modkeys(window),
 
@@ -397,43 +503,27 @@ rtb__platform_mouse_wheel(struct rtb_window *window, int x, int y, float delta)
 			.y = y}
 	};
 
+	rtb__platform_mouse_flush_motion(window);
+
+	target = element_underneath_mouse(window);
+	ev.target = target;
+
 	rtb_dispatch_raw(target, RTB_EVENT(&ev));
 }
 
 void
 rtb__platform_mouse_enter_window(struct rtb_window *win, int x, int y)
 {
-	if (win->mouse_in)
-		rtb__platform_mouse_leave_window(win, x, y);
-
-	win->mouse_in = 1;
-	win->mouse.element_underneath = RTB_ELEMENT(win);
-
-	dispatch_simple_mouse_event(win, RTB_ELEMENT(win),
-			RTB_MOUSE_ENTER, -1, x, y);
-
-	/* XXX: only on x11-xcb? */
-	rtb__platform_mouse_motion(win, x, y);
+	rtb__platform_mouse_flush_motion(win);
+	record_motion(&win->mouse, x, y);
+	enter_window(win, x, y);
 }
 
 void
 rtb__platform_mouse_leave_window(struct rtb_window *win, int x, int y)
 {
-	struct rtb_element *underneath = element_underneath_mouse(win);
-
-	while (underneath) {
-		underneath->mouse_in = 0;
-		dispatch_simple_mouse_event(
-				win, underneath, RTB_MOUSE_LEAVE, -1, x, y);
-
-		if (win->mouse.buttons_down)
-			dispatch_drag_leave(win, underneath, x, y);
-
-		underneath = underneath->parent;
-	}
-
-	win->mouse.element_underneath = NULL;
-	win->mouse_in = 0;
+	rtb__platform_mouse_flush_motion(win);
+	leave_window(win, x, y);
 }
 
 /**
@@ -453,3 +543,20 @@ rtb_mouse_unset_cursor(struct rtb_window *win, struct rtb_mouse *mouse)
 {
 	rtb_mouse_set_cursor(win, mouse, RTB_MOUSE_CURSOR_DEFAULT);
 }
+
+void
+rtb_mouse_set_motion_coalescing(struct rtb_window *win, struct rtb_mouse *mouse,
+		int coalesce)
+{
+	if (!coalesce)
+		rtb__platform_mouse_flush_motion(win);
+
+	mouse->coalesce_motion = !!coalesce;
+}
+
+const struct rtb_mouse_motion *
+rtb_mouse_get_motion_history(struct rtb_mouse *mouse, int *count)
+{
+	*count = mouse->history.count;
+	return mouse->history.samples;
+}
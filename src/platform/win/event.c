@@ -55,6 +55,8 @@ draw_frame(struct win_rtb_window *self, int force)
 {
 	LOCK(self);
 
+	rtb__platform_mouse_flush_motion(RTB_WINDOW(self));
+
 	if (rtb_window_draw(RTB_WINDOW(self), force))
 		SwapBuffers(self->dc);
 
@@ -52,9 +52,8 @@
 
 #include "xrtb.h"
 
-#ifndef GL_ARB_timer_query
-#define GL_TIME_ELAPSED 0x88BF
-#define GL_TIMESTAMP 0x8E28
+#ifndef GLX_EXT_buffer_age
+#define GLX_BACK_BUFFER_AGE_EXT 0x20F4
 #endif
 
 #define CAST_EVENT_TO(type) type *ev = (type *) _ev
@@ -420,6 +419,9 @@ handle_generic_event(struct xrtb_window *win, xcb_generic_event_t *ev)
 		break;
 
 	case XCB_EXPOSE:
+		/* the back buffer might still be intact, but what's on screen
+		 * isn't, so all of it needs to go out again. */
+		rtb_surface_damage(RTB_SURFACE(win), &win->rect);
 		win->dirty = 1;
 		break;
 
@@ -454,11 +456,14 @@ static int
 drain_xcb_event_queue(xcb_connection_t *conn, struct rtb_window *win)
 {
 	xcb_generic_event_t *ev;
+	uint64_t start;
 	int ret;
 
 	while ((ev = xcb_poll_for_event(conn))) {
 		rtb_window_lock(win);
+		start = uv_hrtime();
 		ret = handle_generic_event(RTB_WINDOW_AS(win, xrtb_window), ev);
+		win->frame_stats.event_ns += uv_hrtime() - start;
 		rtb_window_unlock(win);
 
 		free(ev);
@@ -522,6 +527,8 @@ frame_cb(uv_timer_t *_handle)
 	struct xrtb_window *xwin;
 	struct rtb_window *win;
 	struct video_sync *sync;
+	unsigned int age;
+	uint64_t start;
 
 	timer = RTB_DOWNCAST(_handle, xrtb_frame_timer, uv_timer_s);
 	xwin = timer->xwin;
@@ -532,6 +539,18 @@ frame_cb(uv_timer_t *_handle)
 
 	rtb_window_lock(win);
 
+	/* any motion that came in since the last frame and was held back
+	 * by motion coalescing goes out now, as one event. */
+	start = uv_hrtime();
+	rtb__platform_mouse_flush_motion(win);
+	win->frame_stats.event_ns += uv_hrtime() - start;
+
+	if (xwin->has_buffer_age) {
+		glXQueryDrawable(xwin->xrtb->dpy, xwin->gl_draw,
+				GLX_BACK_BUFFER_AGE_EXT, &age);
+		win->buffer_age = age;
+	}
+
 	if (rtb_window_draw(win, 0)) {
 		if (sync->functions_valid) {
 			sync->msc++;
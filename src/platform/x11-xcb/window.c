@@ -421,6 +421,22 @@ new_gl_context(Display *dpy, GLXFBConfig fb_config)
 	return ctx;
 }
 
+static int
+has_glx_extension(Display *dpy, int screen, const char *name)
+{
+	const char *exts, *p;
+	size_t len;
+
+	exts = glXQueryExtensionsString(dpy, screen);
+	len  = strlen(name);
+
+	for (p = exts; p && (p = strstr(p, name)); p += len)
+		if ((p == exts || p[-1] == ' ') && (!p[len] || p[len] == ' '))
+			return 1;
+
+	return 0;
+}
+
 static void
 raise_window(xcb_connection_t *xcb_conn, xcb_window_t window)
 {
@@ -557,6 +573,8 @@ window_impl_open(struct rutabaga *rtb,
 		set_xprop(xcb_conn, self->xcb_win, XCB_ATOM_WM_NAME, "oh no");
 
 	self->gl_draw = self->gl_win;
+	self->has_buffer_age =
+		has_glx_extension(dpy, default_screen, "GLX_EXT_buffer_age");
 
 	if (!glXMakeContextCurrent(
 				dpy, self->gl_draw, self->gl_draw, self->gl_ctx)) {
@@ -125,6 +125,8 @@ struct xrtb_window {
 	GLXContext gl_ctx;
 	GLXWindow gl_win;
 
+	int has_buffer_age;
+
 	uint16_t numlock_mask;
 	uint16_t capslock_mask;
 	uint16_t shiftlock_mask;
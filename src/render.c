@@ -24,14 +24,21 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <math.h>
+
 #include "rutabaga/rutabaga.h"
 #include "rutabaga/window.h"
+#include "rutabaga/surface.h"
 #include "rutabaga/render.h"
 #include "rutabaga/style.h"
 #include "rutabaga/quad.h"
+#include "rutabaga/font-manager.h"
 
+#include "rtb_private/stdlib-allocator.h"
 #include "rtb_private/util.h"
 
+static void apply_target(struct rtb_render_context *);
+
 /**
  * public API
  *
@@ -43,8 +50,8 @@ rtb_render_use_style_fg(struct rtb_render_context *ctx,
 		struct rtb_element *from)
 {
 	const struct rtb_style_property_definition *prop;
-	prop = rtb_style_query_prop(from,
-			"background-color", RTB_STYLE_PROP_COLOR, 1);
+	prop = rtb_style_query(from,
+			RTB_STYLE_KEY_BACKGROUND_COLOR, RTB_STYLE_PROP_COLOR, 1);
 
 	rtb_render_set_color(ctx,
 			prop->color.r,
@@ -58,8 +65,8 @@ rtb_render_use_style_bg(struct rtb_render_context *ctx,
 		struct rtb_element *from)
 {
 	const struct rtb_style_property_definition *prop;
-	prop = rtb_style_query_prop(from,
-			"color", RTB_STYLE_PROP_COLOR, 1);
+	prop = rtb_style_query(from,
+			RTB_STYLE_KEY_COLOR, RTB_STYLE_PROP_COLOR, 1);
 
 	rtb_render_set_color(ctx,
 			prop->color.r,
@@ -72,18 +79,21 @@ void
 rtb_render_set_color(struct rtb_render_context *ctx,
 		GLfloat r, GLfloat g, GLfloat b, GLfloat a)
 {
+	apply_target(ctx);
 	glUniform4f(ctx->shader->color, r, g, b, a);
 }
 
 void
 rtb_render_set_position(struct rtb_render_context *ctx, float x, float y)
 {
+	apply_target(ctx);
 	glUniform2f(ctx->shader->offset, x, y);
 }
 
 void
 rtb_render_set_modelview(struct rtb_render_context *ctx, const GLfloat *matrix)
 {
+	apply_target(ctx);
 	glUniformMatrix4fv(ctx->shader->matrices.modelview,
 		1, GL_FALSE, matrix);
 }
@@ -101,6 +111,8 @@ render_quad(struct rtb_render_context *ctx, struct rtb_quad *quad,
 	if (!quad->vertices)
 		return;
 
+	apply_target(ctx);
+
 	glBindBuffer(GL_ARRAY_BUFFER, quad->vertices);
 	glEnableVertexAttribArray(shader->vertex);
 	glVertexAttribPointer(shader->vertex, 2, GL_FLOAT, GL_FALSE, 0, 0);
@@ -117,6 +129,7 @@ render_quad(struct rtb_render_context *ctx, struct rtb_quad *quad,
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
 	glDrawElements(mode, 4, GL_UNSIGNED_BYTE, 0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	ctx->window->frame_stats.draw_calls++;
 
 	glDisableVertexAttribArray(shader->vertex);
 
@@ -141,10 +154,277 @@ rtb_render_quad(struct rtb_render_context *ctx, struct rtb_quad *quad)
 void
 rtb_render_clear(struct rtb_element *elem)
 {
+	apply_target(rtb_render_get_context(elem));
+
 	glClearColor(0.f, 0.f, 0.f, 0.f);
 	glClear(GL_COLOR_BUFFER_BIT);
 }
 
+/**
+ * batching
+ */
+
+/* VECTOR_PUSH_BACK_DATA() only grows by exactly what it needs, which
+ * would mean a realloc() for nearly every stylequad. */
+#define BATCH_RESERVE(vec, count) do {                                 \
+	size_t capacity = (vec)->capacity;                                \
+	if ((vec)->size + (count) < capacity)                             \
+		break;                                                        \
+	while ((vec)->size + (count) >= capacity)                         \
+		capacity *= 2;                                                \
+	(vec)->data = (vec)->allocator->realloc((vec)->data,              \
+			capacity * sizeof(*(vec)->data));                         \
+	(vec)->capacity = capacity;                                       \
+} while (0)
+
+static void
+union_rect(struct rtb_rect *bounds, const struct rtb_rect *rect, int first)
+{
+	if (first) {
+		*bounds = *rect;
+		return;
+	}
+
+	bounds->x  = MIN(bounds->x,  rect->x);
+	bounds->y  = MIN(bounds->y,  rect->y);
+	bounds->x2 = MAX(bounds->x2, rect->x2);
+	bounds->y2 = MAX(bounds->y2, rect->y2);
+}
+
+static int
+rects_overlap(const struct rtb_rect *a, const struct rtb_rect *b)
+{
+	return a->x < b->x2 && a->x2 > b->x && a->y < b->y2 && a->y2 > b->y;
+}
+
+/* whether anything drawn into `rect` would end up on top of text that's
+ * still waiting in the text batch. */
+static int
+covers_pending_text(struct rtb_render_context *ctx,
+		const struct rtb_rect *rect)
+{
+	struct rtb_text_batch *text = &ctx->text;
+	size_t i;
+
+	if (!text->vertices.size || !rects_overlap(rect, &text->bounds))
+		return 0;
+
+	for (i = 0; i < text->rects.size; i++)
+		if (rects_overlap(rect, &text->rects.data[i]))
+			return 1;
+
+	return 0;
+}
+
+static void
+batch_draw(struct rtb_render_context *ctx)
+{
+	struct rtb_batch_shader *shader =
+		&ctx->window->local_storage.shader.batch;
+	struct rtb_render_batch *batch = &ctx->batch;
+	GLsizei stride = sizeof(struct rtb_render_vertex);
+
+	glUseProgram(shader->program);
+	glUniformMatrix4fv(shader->matrices.projection,
+		1, GL_FALSE, ctx->projection.data);
+
+	rtb_render_scissor(ctx, &batch->bounds);
+
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	glBindBuffer(GL_ARRAY_BUFFER, batch->vbo);
+	glBufferData(GL_ARRAY_BUFFER, batch->vertices.size * stride,
+			batch->vertices.data, GL_STREAM_DRAW);
+	ctx->window->frame_stats.buffer_uploads++;
+
+#define ATTRIB(location, size, member) do {                           \
+	glEnableVertexAttribArray(location);                              \
+	glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE, stride, \
+			(void *) offsetof(struct rtb_render_vertex, member));     \
+} while (0)
+
+	ATTRIB(shader->vertex,       2, x);
+	ATTRIB(shader->tex_coord,    2, s);
+	ATTRIB(shader->vertex_color, 4, r);
+	ATTRIB(shader->tex_layer,    1, layer);
+#undef ATTRIB
+
+	glBindTexture(GL_TEXTURE_2D, batch->texture);
+	glDrawArrays(GL_TRIANGLES, 0, batch->vertices.size);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	ctx->window->frame_stats.draw_calls++;
+
+	glDisableVertexAttribArray(shader->tex_layer);
+	glDisableVertexAttribArray(shader->vertex_color);
+	glDisableVertexAttribArray(shader->tex_coord);
+	glDisableVertexAttribArray(shader->vertex);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	ctx->shader = RTB_SHADER(shader);
+}
+
+/* whether text in `a` and `b` can go into the same draw. */
+static int
+same_text_state(const struct rtb_font *a, const struct rtb_font *b)
+{
+	return a->fm == b->fm
+		&& a->distance_field == b->distance_field
+		&& a->lcd_gamma == b->lcd_gamma;
+}
+
+static void
+text_batch_draw(struct rtb_render_context *ctx)
+{
+	struct rtb_text_batch *text = &ctx->text;
+	struct rtb_font_manager *fm = text->font->fm;
+	texture_atlas_t *atlas = text->font->txfont->atlas;
+	GLsizei stride = sizeof(struct rtb_text_vertex);
+	struct rtb_font_shader *shader;
+
+	if (text->font->distance_field)
+		shader = &fm->distance_field.shader;
+	else
+		shader = &fm->shader;
+
+	glUseProgram(shader->program);
+	glUniformMatrix4fv(shader->matrices.projection,
+		1, GL_FALSE, ctx->projection.data);
+
+	glUniform1i(shader->texture, 0);
+	glUniform1f(shader->gamma, text->font->lcd_gamma);
+	glUniform3f(shader->atlas_pixel,
+			1.f / atlas->width, 1.f / atlas->height, atlas->depth);
+
+	rtb_render_scissor(ctx, &text->bounds);
+
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	glBindBuffer(GL_ARRAY_BUFFER, text->vbo);
+	glBufferData(GL_ARRAY_BUFFER, text->vertices.size * stride,
+			text->vertices.data, GL_STREAM_DRAW);
+	ctx->window->frame_stats.buffer_uploads++;
+
+/* the distance field shader has no use for the subpixel shift. */
+#define ATTRIB(location, size, member) do {                           \
+	if ((location) < 0)                                               \
+		break;                                                        \
+	glEnableVertexAttribArray(location);                              \
+	glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE, stride, \
+			(void *) offsetof(struct rtb_text_vertex, member));       \
+} while (0)
+
+	ATTRIB(shader->vertex,         2, x);
+	ATTRIB(shader->tex_coord,      2, s);
+	ATTRIB(shader->subpixel_shift, 1, shift);
+	ATTRIB(shader->vertex_color,   4, r);
+#undef ATTRIB
+
+	glBindTexture(GL_TEXTURE_2D, atlas->id);
+	glDrawArrays(GL_TRIANGLES, 0, text->vertices.size);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	ctx->window->frame_stats.draw_calls++;
+
+	glDisableVertexAttribArray(shader->vertex_color);
+	if (shader->subpixel_shift >= 0)
+		glDisableVertexAttribArray(shader->subpixel_shift);
+	glDisableVertexAttribArray(shader->tex_coord);
+	glDisableVertexAttribArray(shader->vertex);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	ctx->shader = RTB_SHADER(shader);
+}
+
+void
+rtb_render_batch_add(struct rtb_render_context *ctx,
+		struct rtb_element *on, GLuint texture,
+		const struct rtb_render_vertex *vertices, size_t count)
+{
+	struct rtb_render_batch *batch = &ctx->batch;
+
+	if (!count)
+		return;
+
+	/* the quad batch is drawn first, so it can't take anything that
+	 * belongs on top of text that hasn't been drawn yet. */
+	if (covers_pending_text(ctx, &on->rect))
+		rtb_render_flush(ctx);
+
+	if (texture) {
+		if (batch->texture && batch->texture != texture)
+			rtb_render_flush(ctx);
+
+		batch->texture = texture;
+	}
+
+	union_rect(&batch->bounds, &on->rect, !batch->vertices.size);
+
+	BATCH_RESERVE(&batch->vertices, count);
+	VECTOR_PUSH_BACK_DATA(&batch->vertices, vertices, count);
+
+	if (!ctx->batching)
+		rtb_render_flush(ctx);
+}
+
+/* hands out room for `count` vertices at the end of the text batch. they
+ * only become part of it once rtb_render_text_commit() is called. */
+struct rtb_text_vertex *
+rtb_render_text_reserve(struct rtb_render_context *ctx,
+		const struct rtb_font *font, size_t count)
+{
+	struct rtb_text_batch *text = &ctx->text;
+
+	if (text->vertices.size && !same_text_state(text->font, font))
+		rtb_render_flush(ctx);
+
+	text->font = font;
+
+	BATCH_RESERVE(&text->vertices, count);
+	return text->vertices.data + text->vertices.size;
+}
+
+void
+rtb_render_text_commit(struct rtb_render_context *ctx,
+		const struct rtb_rect *area, size_t count)
+{
+	struct rtb_text_batch *text = &ctx->text;
+
+	if (!count)
+		return;
+
+	union_rect(&text->bounds, area, !text->vertices.size);
+	VECTOR_PUSH_BACK(&text->rects, area);
+	text->vertices.size += count;
+
+	if (!ctx->batching)
+		rtb_render_flush(ctx);
+}
+
+void
+rtb_render_flush(struct rtb_render_context *ctx)
+{
+	struct rtb_render_batch *batch = &ctx->batch;
+	struct rtb_text_batch *text = &ctx->text;
+
+	if (!batch->vertices.size && !text->vertices.size)
+		return;
+
+	if (batch->vertices.size)
+		batch_draw(ctx);
+
+	if (text->vertices.size)
+		text_batch_draw(ctx);
+
+	VECTOR_CLEAR(&batch->vertices);
+	batch->texture = 0;
+
+	VECTOR_CLEAR(&text->vertices);
+	VECTOR_CLEAR(&text->rects);
+	text->font = NULL;
+
+	/* we've trampled over the scissor, blend func, and program. */
+	ctx->target_applied = 0;
+}
+
 /**
  * state changes
  */
@@ -156,11 +436,66 @@ static const GLfloat identity_matrix[] = {
 	0.f, 0.f, 0.f, 1.f
 };
 
+static void
+set_target_state(struct rtb_render_context *ctx)
+{
+	rtb_render_scissor(ctx, &ctx->target->rect);
+
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	ctx->target_applied = 1;
+}
+
+/* `rect` is in the content coordinates of the context's surface, which
+ * are offset from the surface's framebuffer by its rect and its scroll.
+ *
+ * each edge is snapped to the pixel grid on its own, so that scissoring
+ * to part of a rect and then to the rest of it covers the same pixels as
+ * scissoring to the whole thing would have. */
+void
+rtb_render_scissor(struct rtb_render_context *ctx, const struct rtb_rect *rect)
+{
+	struct rtb_surface *surface = ctx->surface;
+	struct rtb_rect r = *rect;
+	GLfloat left, right, top, bottom;
+
+	if (ctx->clipping) {
+		r.x  = MAX(r.x,  ctx->clip.x);
+		r.y  = MAX(r.y,  ctx->clip.y);
+		r.x2 = MIN(r.x2, ctx->clip.x2);
+		r.y2 = MIN(r.y2, ctx->clip.y2);
+	}
+
+	left   = floorf(r.x  - (surface->x + surface->scroll.x));
+	right  = floorf(r.x2 - (surface->x + surface->scroll.x));
+	top    = floorf(surface->y + surface->h + surface->scroll.y - r.y);
+	bottom = floorf(surface->y + surface->h + surface->scroll.y - r.y2);
+
+	glScissor(left, bottom, MAX(right - left, 0.f), MAX(top - bottom, 0.f));
+}
+
+/* called before anything that touches the GL directly. draws whatever is
+ * sitting in the batch, then brings the GL back to the state that
+ * rtb_render_reset() would have left it in for the current target. */
+static void
+apply_target(struct rtb_render_context *ctx)
+{
+	rtb_render_flush(ctx);
+
+	if (ctx->target && !ctx->target_applied)
+		rtb_render_reset(ctx->target);
+}
+
 void
 rtb_render_use_shader(struct rtb_render_context *ctx,
 		struct rtb_shader *shader)
 {
 	GLuint program;
+
+	rtb_render_flush(ctx);
+
+	if (ctx->target && !ctx->target_applied)
+		set_target_state(ctx);
+
 	program = shader->program;
 	ctx->shader = shader;
 
@@ -176,25 +511,40 @@ void
 rtb_render_reset(struct rtb_element *elem)
 {
 	struct rtb_render_context *ctx = rtb_render_get_context(elem);
-	rtb_render_use_shader(ctx, &elem->window->local_storage.shader.dfault);
 
-	glScissor(elem->x - elem->surface->x,
-			elem->surface->y + elem->surface->h - elem->h - elem->y,
-			elem->w, elem->h);
+	rtb_render_flush(ctx);
 
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	ctx->target = elem;
+	set_target_state(ctx);
+
+	rtb_render_use_shader(ctx, &elem->window->local_storage.shader.dfault);
 }
 
+/* pushing and popping doesn't touch the GL at all, since most elements
+ * only draw a stylequad and that goes into the batch. the state is
+ * applied lazily by the first thing that draws outside of it. */
+
 void
 rtb_render_push(struct rtb_element *elem)
 {
-	rtb_render_reset(elem);
+	struct rtb_render_context *ctx = rtb_render_get_context(elem);
+
+	ctx->target = elem;
+	ctx->target_applied = 0;
 }
 
 void
 rtb_render_pop(struct rtb_element *elem)
 {
-	glUseProgram(0);
+	struct rtb_render_context *ctx = rtb_render_get_context(elem);
+	struct rtb_element *parent = elem->parent;
+
+	if (parent && parent->surface && rtb_render_get_context(parent) == ctx)
+		ctx->target = parent;
+	else
+		ctx->target = NULL;
+
+	ctx->target_applied = 0;
 }
 
 struct rtb_render_context *
@@ -202,3 +552,60 @@ rtb_render_get_context(struct rtb_element *elem)
 {
 	return &elem->surface->render_ctx;
 }
+
+/**
+ * lifecycle
+ */
+
+int
+rtb_render_context_init(struct rtb_render_context *ctx,
+		struct rtb_surface *surface)
+{
+	struct rtb_render_batch *batch = &ctx->batch;
+
+	ctx->window  = NULL;
+	ctx->surface = surface;
+	ctx->shader  = NULL;
+
+	ctx->target = NULL;
+	ctx->target_applied = 0;
+	ctx->clipping = 0;
+
+	glGenBuffers(1, &batch->vbo);
+	if (!batch->vbo)
+		return -1;
+
+	batch->vertices.data = NULL;
+	VECTOR_INIT(&batch->vertices, &stdlib_allocator, 256);
+	batch->texture = 0;
+
+	glGenBuffers(1, &ctx->text.vbo);
+	if (!ctx->text.vbo)
+		goto err_text_vbo;
+
+	ctx->text.vertices.data = NULL;
+	ctx->text.rects.data = NULL;
+	VECTOR_INIT(&ctx->text.vertices, &stdlib_allocator, 256);
+	VECTOR_INIT(&ctx->text.rects, &stdlib_allocator, 16);
+	ctx->text.font = NULL;
+
+	ctx->batching = 1;
+
+	return 0;
+
+err_text_vbo:
+	VECTOR_FREE(&batch->vertices);
+	glDeleteBuffers(1, &batch->vbo);
+	return -1;
+}
+
+void
+rtb_render_context_fini(struct rtb_render_context *ctx)
+{
+	VECTOR_FREE(&ctx->batch.vertices);
+	glDeleteBuffers(1, &ctx->batch.vbo);
+
+	VECTOR_FREE(&ctx->text.vertices);
+	VECTOR_FREE(&ctx->text.rects);
+	glDeleteBuffers(1, &ctx->text.vbo);
+}
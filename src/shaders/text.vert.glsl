@@ -27,14 +27,11 @@
 #version 150
 
 uniform mat4 projection;
-uniform mat4 modelview;
-
-uniform vec2 offset;
-uniform vec4 color;
 
 in vec2 vertex;
 in vec2 tex_coord;
 in float subpixel_shift;
+in vec4 vertex_color;
 
 out float shift;
 out vec2 uv;
@@ -42,12 +39,9 @@ out vec4 front_color;
 
 void main()
 {
-	vec4 offset_vector = vec4(offset.x, offset.y, 0.0, 0.0);
-
 	uv = tex_coord.xy;
 	shift = subpixel_shift;
-	front_color = color;
+	front_color = vertex_color;
 
-	gl_Position = projection *
-		(offset_vector + (modelview * vec4(vertex.xy, 0.0, 1.0)));
+	gl_Position = projection * vec4(vertex.xy, 0.0, 1.0);
 }
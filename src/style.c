@@ -24,6 +24,9 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <stdint.h>
+#include <stdlib.h>
+
 #include "rutabaga/rutabaga.h"
 #include "rutabaga/element.h"
 #include "rutabaga/window.h"
@@ -50,6 +53,26 @@ static const struct rtb_style_property_definition fallbacks[RTB_STYLE_PROP_TYPE_
 	}
 };
 
+static const struct {
+	const char *name;
+	rtb_style_prop_type_t type;
+} keys[RTB_STYLE_KEY_COUNT] = {
+	[RTB_STYLE_KEY_COLOR]            = {"color",            RTB_STYLE_PROP_COLOR},
+	[RTB_STYLE_KEY_BACKGROUND_COLOR] = {"background-color", RTB_STYLE_PROP_COLOR},
+	[RTB_STYLE_KEY_BACKGROUND_IMAGE] = {"background-image", RTB_STYLE_PROP_TEXTURE},
+	[RTB_STYLE_KEY_BORDER_IMAGE]     = {"border-image",     RTB_STYLE_PROP_TEXTURE},
+	[RTB_STYLE_KEY_BORDER_COLOR]     = {"border-color",     RTB_STYLE_PROP_COLOR},
+	[RTB_STYLE_KEY_MIN_WIDTH]        = {"min-width",        RTB_STYLE_PROP_FLOAT},
+	[RTB_STYLE_KEY_MIN_HEIGHT]       = {"min-height",       RTB_STYLE_PROP_FLOAT},
+	[RTB_STYLE_KEY_MAX_WIDTH]        = {"max-width",        RTB_STYLE_PROP_FLOAT},
+	[RTB_STYLE_KEY_MAX_HEIGHT]       = {"max-height",       RTB_STYLE_PROP_FLOAT},
+	[RTB_STYLE_KEY_FLEX_GROW]        = {"flex-grow",        RTB_STYLE_PROP_FLOAT},
+	[RTB_STYLE_KEY_FLEX_SHRINK]      = {"flex-shrink",      RTB_STYLE_PROP_FLOAT},
+	[RTB_STYLE_KEY_GAP]              = {"gap",              RTB_STYLE_PROP_FLOAT},
+	[RTB_STYLE_KEY_FONT]             = {"font",             RTB_STYLE_PROP_FONT},
+	[RTB_STYLE_KEY_KNOB_ROTOR]       = {"-rtb-knob-rotor",  RTB_STYLE_PROP_TEXTURE}
+};
+
 static rtb_draw_state_t
 draw_state_for_elem_state(unsigned int state)
 {
@@ -158,6 +181,28 @@ inherits_from(struct rtb_type_atom_descriptor *type,
 	return NULL;
 }
 
+static void
+index_properties(struct rtb_style *style)
+{
+	struct rtb_style_property_definition *prop;
+	rtb_draw_state_t state;
+
+	for (state = 0; state < RTB_DRAW_STATE_COUNT; state++) {
+		memset(style->by_key[state], 0, sizeof(style->by_key[state]));
+
+		for (prop = style->properties[state]; prop->property_name; prop++) {
+			/* style lists that weren't generated by the stylesheet
+			 * compiler won't have their keys filled in. */
+			if (!prop->key)
+				prop->key = rtb_style_key_for_name(prop->property_name);
+
+			if (prop->key && prop->type == keys[prop->key].type
+					&& !style->by_key[state][prop->key])
+				style->by_key[state][prop->key] = prop;
+		}
+	}
+}
+
 static int
 style_resolve(struct rtb_window *window, struct rtb_style *style)
 {
@@ -168,6 +213,7 @@ style_resolve(struct rtb_window *window, struct rtb_style *style)
 		return -1;
 
 	style->inherit_from = inherits_from(style->resolved_type, style);
+	index_properties(style);
 
 	for (state = 0; state < RTB_DRAW_STATE_COUNT; state++) {
 		if (load_assets(window, style->properties[state]) < 0)
@@ -178,20 +224,278 @@ style_resolve(struct rtb_window *window, struct rtb_style *style)
 	return 0;
 }
 
+/**
+ * texture atlas
+ */
+
+/* texels of padding around each packed image. the padding repeats the
+ * image's edge texels so that linear filtering at the border of one
+ * sub-rectangle doesn't bleed in its neighbours. */
+#define ATLAS_PADDING 1
+#define ATLAS_MIN_WIDTH 64
+
+struct atlas_entry {
+	struct rtb_style_texture_definition *def;
+
+	/* the entry whose pixels this one shares, if any. */
+	struct atlas_entry *same_as;
+	int x, y;
+};
+
+static int
+collect_textures(struct rtb_style *style_list, struct atlas_entry *entries)
+{
+	struct rtb_style_property_definition *prop;
+	rtb_draw_state_t state;
+	int count;
+
+	for (count = 0; style_list->for_type; style_list++) {
+		for (state = 0; state < RTB_DRAW_STATE_COUNT; state++) {
+			prop = style_list->properties[state];
+
+			for (; prop->property_name; prop++) {
+				if (prop->type != RTB_STYLE_PROP_TEXTURE
+						|| !RTB_ASSET_IS_LOADED(RTB_ASSET(&prop->texture)))
+					continue;
+
+				if (entries)
+					entries[count].def = &prop->texture;
+				count++;
+			}
+		}
+	}
+
+	return count;
+}
+
+static void
+find_duplicates(struct atlas_entry *entries, int count)
+{
+	const struct rtb_style_texture_definition *a, *b;
+	int i, j;
+
+	/* the same image is usually referenced by more than one property
+	 * (and, for embedded assets, by the very same pointer). */
+	for (i = 0; i < count; i++) {
+		a = entries[i].def;
+		entries[i].same_as = NULL;
+
+		for (j = 0; j < i; j++) {
+			b = entries[j].def;
+
+			if (!entries[j].same_as && a->w == b->w && a->h == b->h
+					&& RTB_ASSET_DATA(RTB_ASSET(a))
+					== RTB_ASSET_DATA(RTB_ASSET(b))) {
+				entries[i].same_as = &entries[j];
+				break;
+			}
+		}
+	}
+}
+
+static int
+entry_height_cmp(const void *_a, const void *_b)
+{
+	const struct atlas_entry *a = _a, *b = _b;
+
+	if (a->def->h == b->def->h)
+		return 0;
+	return (a->def->h < b->def->h) ? 1 : -1;
+}
+
+/* simple shelf packing. entries are expected to be sorted tallest first.
+ * returns the height of the packed atlas, or -1 if an entry is too wide
+ * to fit. */
+static int
+pack(struct atlas_entry *entries, int count, int width)
+{
+	int i, w, h, x, y, shelf_height;
+
+	x = y = shelf_height = 0;
+
+	for (i = 0; i < count; i++) {
+		if (entries[i].same_as)
+			continue;
+
+		w = entries[i].def->w + (ATLAS_PADDING * 2);
+		h = entries[i].def->h + (ATLAS_PADDING * 2);
+
+		if (w > width)
+			return -1;
+
+		if (x + w > width) {
+			y += shelf_height;
+			x = shelf_height = 0;
+		}
+
+		entries[i].x = x + ATLAS_PADDING;
+		entries[i].y = y + ATLAS_PADDING;
+
+		x += w;
+		if (h > shelf_height)
+			shelf_height = h;
+	}
+
+	return y + shelf_height;
+}
+
+static void
+blit(uint32_t *atlas, int stride, const struct atlas_entry *entry)
+{
+	const struct rtb_style_texture_definition *def = entry->def;
+	const uint32_t *src = RTB_ASSET_DATA(RTB_ASSET(def));
+	int x, y, sx, sy, w = def->w, h = def->h;
+	uint32_t *dst;
+
+#define CLAMP(v, hi) ((v) < 0 ? 0 : ((v) > (hi) ? (hi) : (v)))
+
+	for (y = -ATLAS_PADDING; y < h + ATLAS_PADDING; y++) {
+		dst = &atlas[(entry->y + y) * stride + entry->x];
+		sy = CLAMP(y, h - 1);
+
+		for (x = -ATLAS_PADDING; x < w + ATLAS_PADDING; x++) {
+			sx = CLAMP(x, w - 1);
+			dst[x] = src[sy * w + sx];
+		}
+	}
+
+#undef CLAMP
+}
+
+static unsigned int atlas_generation = 0;
+
+static int
+region_cmp(const void *_a, const void *_b)
+{
+	const struct rtb_style_atlas_region *a = _a, *b = _b;
+
+	if (a->def == b->def)
+		return 0;
+	return ((uintptr_t) a->def < (uintptr_t) b->def) ? -1 : 1;
+}
+
+static int
+atlas_build(struct rtb_style_atlas *atlas, struct rtb_style *style_list)
+{
+	struct atlas_entry *entries, *entry;
+	GLint max_size;
+	uint32_t *pixels;
+	int i, count;
+
+	rtb_style_atlas_fini(atlas);
+	atlas->generation = ++atlas_generation;
+
+	count = collect_textures(style_list, NULL);
+	if (!count)
+		return 0;
+
+	if (!(entries = calloc(count, sizeof(*entries))))
+		goto err_entries;
+
+	collect_textures(style_list, entries);
+
+	for (i = 0; i < count; i++) {
+		struct rtb_style_texture_definition *def = entries[i].def;
+
+		/* a short asset would have us read off the end of it. */
+		if (RTB_ASSET_SIZE(RTB_ASSET(def))
+				< (size_t) (def->w * def->h) * sizeof(*pixels))
+			goto err_size;
+	}
+
+	qsort(entries, count, sizeof(*entries), entry_height_cmp);
+	find_duplicates(entries, count);
+
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+
+	for (atlas->w = ATLAS_MIN_WIDTH; atlas->w <= max_size; atlas->w *= 2) {
+		atlas->h = pack(entries, count, atlas->w);
+
+		if (atlas->h > 0 && atlas->h <= atlas->w)
+			break;
+	}
+
+	if (atlas->w > max_size)
+		goto err_size;
+
+	if (!(pixels = calloc(atlas->w * atlas->h, sizeof(*pixels))))
+		goto err_pixels;
+
+	if (!(atlas->regions = calloc(count, sizeof(*atlas->regions))))
+		goto err_regions;
+
+	for (i = 0; i < count; i++)
+		if (!entries[i].same_as)
+			blit(pixels, atlas->w, &entries[i]);
+
+	glGenTextures(1, &atlas->gl_handle);
+	glBindTexture(GL_TEXTURE_2D, atlas->gl_handle);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlas->w, atlas->h,
+			0, GL_BGRA, GL_UNSIGNED_BYTE, pixels);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	for (i = 0; i < count; i++) {
+		const struct rtb_style_texture_definition *def = entries[i].def;
+		struct rtb_style_atlas_region *region = &atlas->regions[i];
+
+		entry = entries[i].same_as ? entries[i].same_as : &entries[i];
+
+		region->def = def;
+		region->s  = (GLfloat) entry->x / atlas->w;
+		region->t  = (GLfloat) entry->y / atlas->h;
+		region->s2 = (GLfloat) (entry->x + def->w) / atlas->w;
+		region->t2 = (GLfloat) (entry->y + def->h) / atlas->h;
+	}
+
+	atlas->nregions = count;
+	qsort(atlas->regions, count, sizeof(*atlas->regions), region_cmp);
+
+	free(pixels);
+	free(entries);
+	return 0;
+
+err_regions:
+	free(pixels);
+err_pixels:
+err_size:
+	free(entries);
+err_entries:
+	atlas->w = atlas->h = 0;
+	return -1;
+}
+
 /**
  * queries
  */
 
+/* `property_name` is only looked at when `key` is RTB_STYLE_KEY_UNKNOWN. */
 static const struct rtb_style_property_definition *
-query_no_fallback(struct rtb_style *style_list, rtb_elem_state_t elem_state,
-		const char *property_name, rtb_style_prop_type_t type)
+lookup(struct rtb_style *style_list, rtb_elem_state_t elem_state,
+		rtb_style_key_t key, const char *property_name,
+		rtb_style_prop_type_t type)
 {
-	struct rtb_style_property_definition *prop;
+	const struct rtb_style_property_definition *prop;
 	rtb_draw_state_t draw_state;
 
 	draw_state = draw_state_for_elem_state(elem_state);
 
 	for (; style_list; style_list = style_list->inherit_from) {
+		if (key) {
+			prop = style_list->by_key[draw_state][key];
+
+			if (prop && prop->type == type)
+				return prop;
+
+			continue;
+		}
+
 		prop = style_list->properties[draw_state];
 
 		for (; !!prop->property_name; prop++)
@@ -204,21 +508,21 @@ query_no_fallback(struct rtb_style *style_list, rtb_elem_state_t elem_state,
 }
 
 static const struct rtb_style_property_definition *
-query(struct rtb_style *style_list, rtb_elem_state_t elem_state,
-		const char *property_name, rtb_style_prop_type_t type,
-		int return_fallback)
+resolve(struct rtb_style *style_list, rtb_elem_state_t elem_state,
+		rtb_style_key_t key, const char *property_name,
+		rtb_style_prop_type_t type)
 {
 	const struct rtb_style_property_definition *prop;
 
-	if ((prop = query_no_fallback(style_list,
-					elem_state, property_name, type)))
+	if ((prop = lookup(style_list,
+					elem_state, key, property_name, type)))
 		return prop;
 
 	switch (elem_state) {
 	case RTB_STATE_FOCUS_HOVER:
 	case RTB_STATE_FOCUS_ACTIVE:
-		if ((prop = query_no_fallback(style_list,
-						RTB_STATE_FOCUS, property_name, type)))
+		if ((prop = lookup(style_list,
+						RTB_STATE_FOCUS, key, property_name, type)))
 			return prop;
 
 		/* fall-through */
@@ -226,38 +530,101 @@ query(struct rtb_style *style_list, rtb_elem_state_t elem_state,
 	case RTB_STATE_FOCUS:
 	case RTB_STATE_HOVER:
 	case RTB_STATE_ACTIVE:
-		if ((prop = query_no_fallback(style_list,
-						RTB_STATE_NORMAL, property_name, type)))
+		if ((prop = lookup(style_list,
+						RTB_STATE_NORMAL, key, property_name, type)))
 			return prop;
 
 	default:
 		break;
 	}
 
-	if (return_fallback)
-		return &fallbacks[type];
 	return NULL;
 }
 
+static const struct rtb_style_property_definition *
+query(struct rtb_style *style_list, rtb_elem_state_t elem_state,
+		rtb_style_key_t key, const char *property_name,
+		rtb_style_prop_type_t type, int return_fallback)
+{
+	const struct rtb_style_property_definition *prop;
+
+	if (key && style_list) {
+		prop = style_list->resolved[elem_state].props[key];
+
+		if (prop && prop->type != type)
+			prop = NULL;
+	} else
+		prop = resolve(style_list, elem_state, key, property_name, type);
+
+	if (!prop && return_fallback)
+		return &fallbacks[type];
+	return prop;
+}
+
+static const struct rtb_style_property_definition *
+query_in_tree(struct rtb_element *leaf, rtb_style_key_t key,
+		const char *property_name, rtb_style_prop_type_t type,
+		int return_fallback)
+{
+	const struct rtb_style_property_definition *prop;
+
+	for (prop = NULL; !prop && leaf->parent != leaf; leaf = leaf->parent)
+		prop = query(leaf->style, leaf->state,
+				key, property_name, type, return_fallback);
+
+	return prop;
+}
+
+const struct rtb_style_property_definition *rtb_style_query(
+		struct rtb_element *elem, rtb_style_key_t key,
+		rtb_style_prop_type_t type, int should_return_fallback)
+{
+	return query(elem->style, elem->state,
+			key, NULL, type, should_return_fallback);
+}
+
+const struct rtb_style_property_definition *rtb_style_query_in_tree(
+		struct rtb_element *leaf, rtb_style_key_t key,
+		rtb_style_prop_type_t type, int should_return_fallback)
+{
+	return query_in_tree(leaf, key, NULL, type, should_return_fallback);
+}
+
 const struct rtb_style_property_definition *rtb_style_query_prop(
 		struct rtb_element *elem, const char *property_name,
 		rtb_style_prop_type_t type, int should_return_fallback)
 {
 	return query(elem->style, elem->state,
-			property_name, type, should_return_fallback);
+			rtb_style_key_for_name(property_name), property_name,
+			type, should_return_fallback);
 }
 
 const struct rtb_style_property_definition *rtb_style_query_prop_in_tree(
 		struct rtb_element *leaf, const char *property_name,
 		rtb_style_prop_type_t type, int should_return_fallback)
 {
-	const struct rtb_style_property_definition *prop;
+	return query_in_tree(leaf, rtb_style_key_for_name(property_name),
+			property_name, type, should_return_fallback);
+}
 
-	for (prop = NULL; !prop && leaf->parent != leaf; leaf = leaf->parent)
-		prop = query(leaf->style, leaf->state,
-				property_name, type, should_return_fallback);
+const struct rtb_resolved_style *
+rtb_style_resolved(struct rtb_style *style, rtb_elem_state_t state)
+{
+	if (!style)
+		return NULL;
+	return &style->resolved[state];
+}
 
-	return prop;
+rtb_style_key_t
+rtb_style_key_for_name(const char *property_name)
+{
+	rtb_style_key_t key;
+
+	for (key = RTB_STYLE_KEY_UNKNOWN + 1; key < RTB_STYLE_KEY_COUNT; key++)
+		if (!strcmp(keys[key].name, property_name))
+			return key;
+
+	return RTB_STYLE_KEY_UNKNOWN;
 }
 
 int
@@ -272,6 +639,25 @@ rtb_style_elem_has_properties_for_state(struct rtb_element *elem,
 	return 0;
 }
 
+/**
+ * resolved styles
+ */
+
+static void
+flatten(struct rtb_style *style)
+{
+	rtb_elem_state_t state;
+	rtb_style_key_t key;
+
+	for (state = 0; state < RTB_ELEM_STATE_COUNT; state++) {
+		style->resolved[state].props[RTB_STYLE_KEY_UNKNOWN] = NULL;
+
+		for (key = RTB_STYLE_KEY_UNKNOWN + 1; key < RTB_STYLE_KEY_COUNT; key++)
+			style->resolved[state].props[key] =
+				resolve(style, state, key, NULL, keys[key].type);
+	}
+}
+
 /**
  * public API
  */
@@ -299,9 +685,42 @@ rtb_style_resolve_list(struct rtb_window *win, struct rtb_style *style_list)
 		s->inherit_from = inherits_from(s->resolved_type, style_list);
 	}
 
+	/* has to wait until every style's inherit_from is in place. */
+	for (i = 0; style_list[i].for_type; i++)
+		flatten(&style_list[i]);
+
+	if (atlas_build(&win->style_atlas, style_list))
+		printf("rutabaga: couldn't build style texture atlas\n");
+
 	return unresolved_styles;
 }
 
+void
+rtb_style_atlas_fini(struct rtb_style_atlas *atlas)
+{
+	if (atlas->gl_handle)
+		glDeleteTextures(1, &atlas->gl_handle);
+
+	atlas->gl_handle = 0;
+
+	free(atlas->regions);
+	atlas->regions = NULL;
+	atlas->nregions = 0;
+}
+
+const struct rtb_style_atlas_region *
+rtb_style_atlas_lookup(const struct rtb_style_atlas *atlas,
+		const struct rtb_style_texture_definition *def)
+{
+	struct rtb_style_atlas_region key = {.def = def};
+
+	if (!atlas->nregions)
+		return NULL;
+
+	return bsearch(&key, atlas->regions, atlas->nregions,
+			sizeof(*atlas->regions), region_cmp);
+}
+
 void
 rtb_style_apply_to_tree(struct rtb_element *root, struct rtb_style *style_list)
 {
@@ -35,14 +35,21 @@
 #include "rtb_private/util.h"
 
 /**
- * drawing
+ * immediate drawing
  */
 
+/* stylequads don't own any buffers. the immediate path streams their
+ * CPU-side geometry through a VBO shared by the whole window, vertices
+ * first and texture coordinates right after. */
+#define TEX_COORDS_OFFSET (sizeof(((struct rtb_stylequad *) 0)->geometry))
+
 static void
-draw_solid(const struct rtb_stylequad *self, const struct rtb_shader *shader,
-		GLenum mode, GLuint ibo, GLsizei count)
+draw_solid(struct rtb_render_context *ctx, GLenum mode, GLuint ibo,
+		GLsizei count)
 {
-	glBindBuffer(GL_ARRAY_BUFFER, self->vertices);
+	const struct rtb_shader *shader = ctx->shader;
+
+	glBindBuffer(GL_ARRAY_BUFFER, ctx->window->local_storage.vbo.stylequad);
 	glEnableVertexAttribArray(shader->vertex);
 	glVertexAttribPointer(shader->vertex, 2, GL_FLOAT, GL_FALSE, 0, 0);
 
@@ -51,34 +58,41 @@ draw_solid(const struct rtb_stylequad *self, const struct rtb_shader *shader,
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
 	glDrawElements(mode, count, GL_UNSIGNED_BYTE, 0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	ctx->window->frame_stats.draw_calls++;
 
 	glDisableVertexAttribArray(shader->vertex);
 }
 
 static void
 draw_textured(struct rtb_render_context *ctx,
-		const struct rtb_stylequad *self,
 		const struct rtb_stylequad_texture *tx, int border)
 {
 	const struct rtb_shader *shader = ctx->shader;
 
-	glBindTexture(GL_TEXTURE_2D, tx->gl_handle);
+	if (!tx->in_atlas)
+		return;
+
+	glBindTexture(GL_TEXTURE_2D, ctx->window->style_atlas.gl_handle);
 	glUniform1i(shader->texture, 0);
 	glUniform2f(shader->texture_size,
 			tx->definition->w, tx->definition->h);
 
-	glBindBuffer(GL_ARRAY_BUFFER, tx->coords);
+	glBindBuffer(GL_ARRAY_BUFFER, ctx->window->local_storage.vbo.stylequad);
+	glBufferSubData(GL_ARRAY_BUFFER, TEX_COORDS_OFFSET,
+			sizeof(tx->tex_coords), tx->tex_coords);
+	ctx->window->frame_stats.buffer_uploads++;
+
 	glEnableVertexAttribArray(shader->tex_coord);
 	glVertexAttribPointer(shader->tex_coord,
-			2, GL_FLOAT, GL_FALSE, 0, 0);
+			2, GL_FLOAT, GL_FALSE, 0, (void *) TEX_COORDS_OFFSET);
 
 	/* XXX: hardcoded `count` value here */
 	if (border)
-		draw_solid(self, shader, GL_TRIANGLES,
+		draw_solid(ctx, GL_TRIANGLES,
 				ctx->window->local_storage.ibo.stylequad.border, 48);
 
 	if (!border || tx->definition->flags & RTB_TEXTURE_FILL)
-		draw_solid(self, shader, GL_TRIANGLE_STRIP,
+		draw_solid(ctx, GL_TRIANGLE_STRIP,
 				ctx->window->local_storage.ibo.stylequad.solid, 4);
 
 	glDisableVertexAttribArray(shader->tex_coord);
@@ -95,6 +109,12 @@ draw(struct rtb_render_context *ctx, const struct rtb_stylequad *self,
 	rtb_render_set_position(ctx, center->x, center->y);
 	glUniform2f(shader->texture_size, 0.f, 0.f);
 
+	glBindBuffer(GL_ARRAY_BUFFER, ctx->window->local_storage.vbo.stylequad);
+	glBufferSubData(GL_ARRAY_BUFFER, 0,
+			sizeof(self->geometry), self->geometry);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	ctx->window->frame_stats.buffer_uploads++;
+
 	if (self->properties.bg_color) {
 		rtb_render_set_color(ctx,
 				self->properties.bg_color->r,
@@ -102,15 +122,15 @@ draw(struct rtb_render_context *ctx, const struct rtb_stylequad *self,
 				self->properties.bg_color->b,
 				self->properties.bg_color->a);
 
-		draw_solid(self, shader, GL_TRIANGLE_STRIP,
+		draw_solid(ctx, GL_TRIANGLE_STRIP,
 				ctx->window->local_storage.ibo.stylequad.solid, 4);
 	}
 
 	if (self->background_image.definition)
-		draw_textured(ctx, self, &self->background_image, 0);
+		draw_textured(ctx, &self->background_image, 0);
 
 	if (self->border_image.definition)
-		draw_textured(ctx, self, &self->border_image, 1);
+		draw_textured(ctx, &self->border_image, 1);
 
 	if (self->properties.border_color) {
 		rtb_render_set_color(ctx,
@@ -121,11 +141,172 @@ draw(struct rtb_render_context *ctx, const struct rtb_stylequad *self,
 
 		glLineWidth(1.f);
 
-		draw_solid(self, shader, GL_LINE_LOOP,
+		draw_solid(ctx, GL_LINE_LOOP,
 				ctx->window->local_storage.ibo.stylequad.outline, 4);
 	}
 }
 
+/**
+ * batched drawing
+ */
+
+/* the four corners of each cell of the 9-slice, clockwise from the top
+ * left. the middle cell doubles as the quad for solid fills. */
+static const GLubyte slices[9][4] = {
+	{ 0,  1,  2,  3}, { 1,  4,  7,  2}, { 4,  5,  6,  7},
+	{ 3,  2,  9,  8}, { 2,  7, 12,  9}, { 7,  6, 13, 12},
+	{ 8,  9, 10, 11}, { 9, 12, 15, 10}, {12, 13, 14, 15}
+};
+
+#define MIDDLE_SLICE 4
+
+static void
+emit_vertex(struct rtb_render_vertex *v, const struct rtb_stylequad *self,
+		const mat4 *modelview, const GLfloat pos[2], const GLfloat tex[2],
+		const struct rtb_rgb_color *color)
+{
+	if (modelview) {
+		const float *m = modelview->data;
+
+		v->x = (m[0] * pos[0]) + (m[4] * pos[1]) + m[12];
+		v->y = (m[1] * pos[0]) + (m[5] * pos[1]) + m[13];
+	} else {
+		v->x = pos[0];
+		v->y = pos[1];
+	}
+
+	v->x += self->offset.x;
+	v->y += self->offset.y;
+
+	if (color) {
+		v->s = v->t = 0.f;
+
+		v->r = color->r;
+		v->g = color->g;
+		v->b = color->b;
+		v->a = color->a;
+		v->layer = -1.f;
+	} else {
+		v->s = tex[0];
+		v->t = tex[1];
+
+		v->r = v->g = v->b = v->a = 1.f;
+		v->layer = 0.f;
+	}
+}
+
+/* emits two triangles and returns a pointer just past them. `tex` is
+ * ignored if `color` is passed. */
+static struct rtb_render_vertex *
+emit_quad(struct rtb_render_vertex *v, const struct rtb_stylequad *self,
+		const mat4 *modelview, const GLfloat (*pos)[2],
+		const GLfloat (*tex)[2], const GLubyte corners[4],
+		const struct rtb_rgb_color *color)
+{
+	static const int order[] = {0, 1, 2, 0, 2, 3};
+	int i, c;
+
+	for (i = 0; i < (int) ARRAY_LENGTH(order); i++) {
+		c = corners[order[i]];
+		emit_vertex(v++, self, modelview, pos[c], tex ? tex[c] : NULL,
+				color);
+	}
+
+	return v;
+}
+
+static void
+batch_textured(struct rtb_render_context *ctx,
+		const struct rtb_stylequad *self, struct rtb_element *on,
+		const mat4 *modelview, const struct rtb_stylequad_texture *tx,
+		int border)
+{
+	struct rtb_render_vertex v[ARRAY_LENGTH(slices) * 6], *end = v;
+	int i;
+
+	if (!tx->in_atlas)
+		return;
+
+	for (i = 0; i < (int) ARRAY_LENGTH(slices); i++) {
+		if (border && i == MIDDLE_SLICE
+				&& !(tx->definition->flags & RTB_TEXTURE_FILL))
+			continue;
+		else if (!border && i != MIDDLE_SLICE)
+			continue;
+
+		end = emit_quad(end, self, modelview,
+				self->geometry, tx->tex_coords, slices[i], NULL);
+	}
+
+	rtb_render_batch_add(ctx, on, ctx->window->style_atlas.gl_handle,
+			v, end - v);
+}
+
+static void
+batch_outline(struct rtb_render_context *ctx,
+		const struct rtb_stylequad *self, struct rtb_element *on,
+		const mat4 *modelview)
+{
+	static const GLubyte corners[4] = {0, 1, 2, 3};
+	struct rtb_render_vertex v[4 * 6], *end = v;
+	int i;
+
+	/* GL_LINE_LOOP can't share a draw call with triangles, so the
+	 * outline is drawn as four one-pixel-wide quads just inside the
+	 * edges instead. */
+
+	GLfloat
+		x  = self->geometry[2][0],
+		y  = self->geometry[2][1],
+		x2 = self->geometry[12][0],
+		y2 = self->geometry[12][1];
+
+	GLfloat edges[4][4][2] = {
+		{{x,        y},        {x2,       y},
+		 {x2,       y + 1.f},  {x,        y + 1.f}},
+		{{x2 - 1.f, y + 1.f},  {x2,       y + 1.f},
+		 {x2,       y2 - 1.f}, {x2 - 1.f, y2 - 1.f}},
+		{{x,        y2 - 1.f}, {x2,       y2 - 1.f},
+		 {x2,       y2},       {x,        y2}},
+		{{x,        y + 1.f},  {x + 1.f,  y + 1.f},
+		 {x + 1.f,  y2 - 1.f}, {x,        y2 - 1.f}}
+	};
+
+	for (i = 0; i < (int) ARRAY_LENGTH(edges); i++)
+		end = emit_quad(end, self, modelview, edges[i], NULL, corners,
+				self->properties.border_color);
+
+	rtb_render_batch_add(ctx, on, 0, v, end - v);
+}
+
+static void
+batch(struct rtb_render_context *ctx, const struct rtb_stylequad *self,
+		struct rtb_element *on, const mat4 *modelview)
+{
+	struct rtb_render_vertex v[6], *end;
+
+	if (self->properties.bg_color) {
+		end = emit_quad(v, self, modelview, self->geometry, NULL,
+				slices[MIDDLE_SLICE], self->properties.bg_color);
+		rtb_render_batch_add(ctx, on, 0, v, end - v);
+	}
+
+	if (self->background_image.definition)
+		batch_textured(ctx, self, on, modelview,
+				&self->background_image, 0);
+
+	if (self->border_image.definition)
+		batch_textured(ctx, self, on, modelview,
+				&self->border_image, 1);
+
+	if (self->properties.border_color)
+		batch_outline(ctx, self, on, modelview);
+}
+
+/**
+ * public drawing API
+ */
+
 void
 rtb_stylequad_draw(const struct rtb_stylequad *self,
 		struct rtb_render_context *ctx, const struct rtb_point *center)
@@ -140,6 +321,11 @@ rtb_stylequad_draw_on_element(struct rtb_stylequad *self,
 	struct rtb_shader *shader = &on->window->local_storage.shader.stylequad;
 	struct rtb_render_context *ctx = rtb_render_get_context(on);
 
+	if (ctx->batching) {
+		batch(ctx, self, on, NULL);
+		return;
+	}
+
 	rtb_render_reset(on);
 	rtb_render_use_shader(ctx, shader);
 
@@ -153,6 +339,11 @@ rtb_stylequad_draw_with_modelview(struct rtb_stylequad *self, struct rtb_element
 	struct rtb_shader *shader = &on->window->local_storage.shader.stylequad;
 	struct rtb_render_context *ctx = rtb_render_get_context(on);
 
+	if (ctx->batching) {
+		batch(ctx, self, on, modelview);
+		return;
+	}
+
 	rtb_render_reset(on);
 	rtb_render_use_shader(ctx, shader);
 	rtb_render_set_modelview(ctx, modelview->data);
@@ -199,9 +390,7 @@ set_border_tex_coords(struct rtb_stylequad_texture *tx)
 		{1.f - bdr_rgt, 0.f},
 	};
 
-	glBindBuffer(GL_ARRAY_BUFFER, tx->coords);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(v), v, GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	memcpy(tx->tex_coords, v, sizeof(tx->tex_coords));
 }
 
 static void
@@ -214,9 +403,7 @@ set_background_tex_coords(struct rtb_stylequad_texture *tx)
 		[12] = {1.f, 0.f}
 	};
 
-	glBindBuffer(GL_ARRAY_BUFFER, tx->coords);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(v), v, GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	memcpy(tx->tex_coords, v, sizeof(tx->tex_coords));
 }
 
 
@@ -228,30 +415,44 @@ load_texture(struct rtb_stylequad_texture *dst,
 	if (dst->definition == src)
 		return -1;
 
-	if (!dst->coords) {
-		glGenBuffers(1, &dst->coords);
-		glGenTextures(1, &dst->gl_handle);
-	}
+	/* the pixels themselves live in the window's style atlas, which
+	 * rtb_style_resolve_list() has already uploaded. where they are in
+	 * it is left to rtb_stylequad_resolve_atlas(). */
+	dst->definition = src;
+	dst->atlas_generation = 0;
+	dst->in_atlas = 0;
+	return 0;
+}
 
-	glBindTexture(GL_TEXTURE_2D, dst->gl_handle);
+/* the coordinates are worked out over the whole [0, 1] range and then
+ * squeezed into the sub-rectangle the style atlas gave the texture. */
+static void
+resolve_texture(struct rtb_stylequad_texture *tx,
+		const struct rtb_style_atlas *atlas,
+		void (*set_tex_coords)(struct rtb_stylequad_texture *))
+{
+	const struct rtb_style_atlas_region *r;
+	int i;
 
-	if (!src) {
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 0, 0,
-				0, GL_BGRA, GL_UNSIGNED_BYTE, NULL);
-	} else {
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8,
-				src->w, src->h,
-				0, GL_BGRA, GL_UNSIGNED_BYTE,
-				RTB_ASSET_DATA(RTB_ASSET(src)));
+	if (!tx->definition || tx->atlas_generation == atlas->generation)
+		return;
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	}
+	tx->atlas_generation = atlas->generation;
 
-	glBindTexture(GL_TEXTURE_2D, 0);
+	r = rtb_style_atlas_lookup(atlas, tx->definition);
+	tx->in_atlas = !!r;
 
-	dst->definition = src;
-	return 0;
+	if (!r)
+		return;
+
+	set_tex_coords(tx);
+
+	for (i = 0; i < 16; i++) {
+		tx->tex_coords[i][0] =
+			r->s + (tx->tex_coords[i][0] * (r->s2 - r->s));
+		tx->tex_coords[i][1] =
+			r->t + (tx->tex_coords[i][1] * (r->t2 - r->t));
+	}
 }
 
 int
@@ -261,9 +462,6 @@ rtb_stylequad_set_border_image(struct rtb_stylequad *self,
 	if (load_texture(&self->border_image, tx))
 		return -1;
 
-	if (tx)
-		set_border_tex_coords(&self->border_image);
-
 	return 0;
 }
 
@@ -274,12 +472,18 @@ rtb_stylequad_set_background_image(struct rtb_stylequad *self,
 	if (load_texture(&self->background_image, tx))
 		return -1;
 
-	if (tx)
-		set_background_tex_coords(&self->background_image);
-
 	return 0;
 }
 
+void
+rtb_stylequad_resolve_atlas(struct rtb_stylequad *self,
+		const struct rtb_style_atlas *atlas)
+{
+	resolve_texture(&self->border_image, atlas, set_border_tex_coords);
+	resolve_texture(&self->background_image, atlas,
+			set_background_tex_coords);
+}
+
 int
 rtb_stylequad_set_background_color(struct rtb_stylequad *self,
 		const struct rtb_rgb_color *color)
@@ -324,7 +528,7 @@ rtb_stylequad_update_geometry(struct rtb_stylequad *self,
 	self->offset.x = rect->x + r.x2;
 	self->offset.y = rect->y + r.y2;
 
-	glBindBuffer(GL_ARRAY_BUFFER, self->vertices);
+	/* this is all CPU-side. reflowing a stylequad doesn't touch GL. */
 
 	if (self->border_image.definition) {
 		const struct rtb_style_texture_definition *tx =
@@ -357,7 +561,7 @@ rtb_stylequad_update_geometry(struct rtb_stylequad *self,
 			{r.x2 - bdr_rgt, r.y2}
 		};
 
-		glBufferData(GL_ARRAY_BUFFER, sizeof(v), v, GL_STATIC_DRAW);
+		memcpy(self->geometry, v, sizeof(v));
 	} else {
 		GLfloat v[16][2] = {
 			[2]  = {r.x,  r.y},
@@ -366,43 +570,21 @@ rtb_stylequad_update_geometry(struct rtb_stylequad *self,
 			[9]  = {r.x,  r.y2}
 		};
 
-		glBufferData(GL_ARRAY_BUFFER, sizeof(v), v, GL_STATIC_DRAW);
+		memcpy(self->geometry, v, sizeof(v));
 	}
-
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 /**
  * lifecycle
  */
 
-#define INIT_STYLEQUAD_TEXTURE(tx) do {										\
-	(tx)->definition = NULL;												\
-	(tx)->coords    = 0;													\
-	(tx)->gl_handle = 0;													\
-} while (0)
-
-#define FINI_STYLEQUAD_TEXTURE(tx) do {										\
-	if ((tx)->coords) {														\
-		glDeleteBuffers(1, &(tx)->coords);									\
-		glDeleteTextures(1, &(tx)->gl_handle);								\
-	}																		\
-} while (0)
-
 void
 rtb_stylequad_init(struct rtb_stylequad *self)
 {
 	memset(self, 0, sizeof(*self));
-	glGenBuffers(1, &self->vertices);
-
-	INIT_STYLEQUAD_TEXTURE(&self->border_image);
-	INIT_STYLEQUAD_TEXTURE(&self->background_image);
 }
 
 void rtb_stylequad_fini(struct rtb_stylequad *self)
 {
-	FINI_STYLEQUAD_TEXTURE(&self->border_image);
-	FINI_STYLEQUAD_TEXTURE(&self->background_image);
-
-	glDeleteBuffers(1, &self->vertices);
+	/* nothing to do, stylequads don't own any GL objects. */
 }
@@ -25,6 +25,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
 
 #include "rutabaga/rutabaga.h"
@@ -47,6 +48,52 @@
 
 static struct rtb_element_implementation super;
 
+static void
+set_projection(struct rtb_surface *self)
+{
+	struct rtb_rect view;
+
+	rtb_surface_view_rect(self, &view);
+	mat4_set_orthographic(&self->render_ctx.projection,
+			view.x, view.x2, view.y2, view.y, -1.f, 1.f);
+}
+
+static void
+free_spare(struct rtb_surface *self)
+{
+	if (!self->spare_fbo)
+		return;
+
+	glDeleteFramebuffers(1, &self->spare_fbo);
+	glDeleteTextures(1, &self->spare_texture);
+
+	self->spare_fbo = 0;
+	self->spare_texture = 0;
+}
+
+static void
+alloc_spare(struct rtb_surface *self)
+{
+	GLint bound_fb;
+
+	glGenTextures(1, &self->spare_texture);
+	glBindTexture(GL_TEXTURE_2D, self->spare_texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
+			lrintf(self->w), lrintf(self->h), 0,
+			GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &bound_fb);
+	glGenFramebuffers(1, &self->spare_fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, self->spare_fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			GL_TEXTURE_2D, self->spare_texture, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, bound_fb);
+}
+
 /**
  * element implementation
  */
@@ -71,6 +118,9 @@ reflow(struct rtb_element *elem, struct rtb_element *instigator,
 		}
 	};
 
+	struct rtb_element *iter;
+	GLint bound_fb;
+
 	SELF_FROM(elem);
 	if (!super.reflow(elem, instigator, direction))
 		return 0;
@@ -78,10 +128,14 @@ reflow(struct rtb_element *elem, struct rtb_element *instigator,
 	if (self->w <= 0 || self->h <= 0)
 		return -1;
 
-	mat4_set_orthographic(&self->render_ctx.projection,
-			self->x, self->x + self->w,
-			self->y + self->h, self->y,
-			-1.f, 1.f);
+	set_projection(self);
+
+	/* the spare has to match the size of the texture, so it'll be made
+	 * again the next time we scroll. we're about to be redrawn from
+	 * scratch anyway, so there's nothing left to move. */
+	free_spare(self);
+	self->pending_scroll.x = 0.f;
+	self->pending_scroll.y = 0.f;
 
 	glBindTexture(GL_TEXTURE_2D, self->texture);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
@@ -92,14 +146,22 @@ reflow(struct rtb_element *elem, struct rtb_element *instigator,
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glBindTexture(GL_TEXTURE_2D, 0);
 
+	/* the platform might be drawing into a framebuffer of its own rather
+	 * than the default one, so put back whatever was bound. */
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &bound_fb);
 	glBindFramebuffer(GL_FRAMEBUFFER, self->fbo);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
 			GL_TEXTURE_2D, self->texture, 0);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, bound_fb);
 
 	rtb_quad_set_vertices(&self->quad, &self->rect);
 	rtb_quad_set_tex_coords(&self->quad, &tex_coords);
 
+	/* children that didn't move may have just come into (or gone out
+	 * of) view. */
+	TAILQ_FOREACH(iter, &self->children, child)
+		rtb_elem_update_visibility(iter);
+
 	rtb_surface_invalidate(self);
 
 	return 1;
@@ -132,15 +194,200 @@ mark_dirty(struct rtb_element *elem)
 		rtb_elem_mark_dirty(RTB_ELEMENT(elem->surface));
 }
 
+/**
+ * damage tracking
+ */
+
+static int
+rect_contains(const struct rtb_rect *outer, const struct rtb_rect *inner)
+{
+	return inner->x >= outer->x && inner->x2 <= outer->x2
+		&& inner->y >= outer->y && inner->y2 <= outer->y2;
+}
+
+static void
+rect_union(struct rtb_rect *dst, const struct rtb_rect *src)
+{
+	dst->x  = MIN(dst->x,  src->x);
+	dst->y  = MIN(dst->y,  src->y);
+	dst->x2 = MAX(dst->x2, src->x2);
+	dst->y2 = MAX(dst->y2, src->y2);
+
+	rtb_rect_update_size_from_points(dst);
+}
+
+void
+rtb_damage_add(struct rtb_damage *damage, const struct rtb_rect *rect)
+{
+	int i;
+
+	if (rect->x >= rect->x2 || rect->y >= rect->y2)
+		return;
+
+	for (i = 0; i < damage->count; i++)
+		if (rect_contains(&damage->rects[i], rect))
+			return;
+
+	if (damage->count < RTB_DAMAGE_MAX_RECTS) {
+		damage->rects[damage->count] = *rect;
+		rtb_rect_update_size_from_points(&damage->rects[damage->count]);
+		damage->count++;
+		return;
+	}
+
+	for (i = 1; i < damage->count; i++)
+		rect_union(&damage->rects[0], &damage->rects[i]);
+
+	rect_union(&damage->rects[0], rect);
+	damage->count = 1;
+}
+
+void
+rtb_damage_clear(struct rtb_damage *damage)
+{
+	damage->count = 0;
+}
+
+/**
+ * scrolling
+ */
+
+/* shifts what we drew last time by however far we've scrolled since,
+ * and fills `exposed` with the parts of the view that it doesn't cover.
+ * returns how many of those there are, or -1 if there was nothing worth
+ * keeping. */
+static int
+move_contents(struct rtb_surface *self, struct rtb_rect exposed[2])
+{
+	GLint dx, dy, w, h, src_x, src_y, dst_x, dst_y, cw, ch;
+	struct rtb_rect view;
+	GLuint swap;
+	int n = 0;
+
+	dx = lrintf(self->pending_scroll.x);
+	dy = lrintf(self->pending_scroll.y);
+	w  = lrintf(self->w);
+	h  = lrintf(self->h);
+
+	self->pending_scroll.x = 0.f;
+	self->pending_scroll.y = 0.f;
+
+	if (!dx && !dy)
+		return 0;
+
+	if (abs(dx) >= w || abs(dy) >= h)
+		return -1;
+
+	if (!self->spare_fbo)
+		alloc_spare(self);
+
+	/* framebuffer rows count upwards, content rows count downwards. */
+	cw = w - abs(dx);
+	ch = h - abs(dy);
+	src_x = dx > 0 ? dx : 0;
+	dst_x = dx < 0 ? -dx : 0;
+	src_y = dy < 0 ? -dy : 0;
+	dst_y = dy > 0 ? dy : 0;
+
+	/* the scissor test applies to blits as well. */
+	glDisable(GL_SCISSOR_TEST);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, self->fbo);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, self->spare_fbo);
+	glBlitFramebuffer(
+			src_x, src_y, src_x + cw, src_y + ch,
+			dst_x, dst_y, dst_x + cw, dst_y + ch,
+			GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+	glEnable(GL_SCISSOR_TEST);
+
+	swap = self->fbo;
+	self->fbo = self->spare_fbo;
+	self->spare_fbo = swap;
+
+	swap = self->texture;
+	self->texture = self->spare_texture;
+	self->spare_texture = swap;
+
+	rtb_surface_view_rect(self, &view);
+
+	if (dx) {
+		exposed[n] = view;
+
+		if (dx > 0)
+			exposed[n].x = view.x2 - dx;
+		else
+			exposed[n].x2 = view.x - dx;
+
+		rtb_rect_update_size_from_points(&exposed[n++]);
+	}
+
+	if (dy) {
+		exposed[n] = view;
+
+		if (dy > 0)
+			exposed[n].y = view.y2 - dy;
+		else
+			exposed[n].y2 = view.y - dy;
+
+		rtb_rect_update_size_from_points(&exposed[n++]);
+	}
+
+	return n;
+}
+
+static void
+draw_exposed(struct rtb_surface *self, const struct rtb_rect *strip)
+{
+	struct rtb_render_context *ctx = &self->render_ctx;
+	struct rtb_element *iter;
+
+	ctx->clip = *strip;
+	ctx->clipping = 1;
+
+	rtb_render_scissor(ctx, strip);
+	glClearColor(0.f, 0.f, 0.f, 0.f);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	/* only our children are checked against the strip. further down,
+	 * things like glyphs can spill out over the edges of their element,
+	 * and it's the scissor that decides what of them ends up drawn. */
+	TAILQ_FOREACH(iter, &self->children, child)
+		if (iter->x < strip->x2 && iter->x2 > strip->x
+				&& iter->y < strip->y2 && iter->y2 > strip->y)
+			rtb_elem_draw(iter, 0);
+
+	rtb_render_flush(ctx);
+
+	ctx->clipping = 0;
+	ctx->target_applied = 0;
+}
+
 /**
  * public API
  */
 
+void
+rtb_surface_damage(struct rtb_surface *self, const struct rtb_rect *rect)
+{
+	struct rtb_rect clipped, view;
+
+	rtb_surface_view_rect(self, &view);
+
+	clipped.x  = MAX(rect->x,  view.x);
+	clipped.y  = MAX(rect->y,  view.y);
+	clipped.x2 = MIN(rect->x2, view.x2);
+	clipped.y2 = MIN(rect->y2, view.y2);
+
+	rtb_damage_add(&self->damage, &clipped);
+}
+
 int
 rtb_surface_is_dirty(struct rtb_surface *self)
 {
 	if (self->surface_state == RTB_SURFACE_VALID &&
-			!TAILQ_FIRST(&self->render_queue)) {
+			!TAILQ_FIRST(&self->render_queue) &&
+			!self->pending_scroll.x && !self->pending_scroll.y) {
 		/* nothing to do. */
 		return 0;
 	}
@@ -148,8 +395,8 @@ rtb_surface_is_dirty(struct rtb_surface *self)
 	return 1;
 }
 
-void
-rtb_surface_blit(struct rtb_surface *self)
+static void
+blit(struct rtb_surface *self, const struct rtb_rect *rect)
 {
 	struct rtb_shader *shader = &self->window->local_storage.shader.surface;
 	struct rtb_element *elem = RTB_ELEMENT(self);
@@ -161,6 +408,9 @@ rtb_surface_blit(struct rtb_surface *self)
 	rtb_render_use_shader(ctx, shader);
 	rtb_render_set_position(ctx, 0, 0);
 
+	if (rect)
+		rtb_render_scissor(ctx, rect);
+
 	glBindTexture(GL_TEXTURE_2D, self->texture);
 	glUniform1i(shader->texture, 0);
 
@@ -174,10 +424,24 @@ rtb_surface_blit(struct rtb_surface *self)
 	LAYOUT_DEBUG_DRAW_BOX(elem);
 }
 
+void
+rtb_surface_blit(struct rtb_surface *self)
+{
+	blit(self, NULL);
+}
+
+void
+rtb_surface_blit_rect(struct rtb_surface *self, const struct rtb_rect *rect)
+{
+	blit(self, rect);
+}
+
 void
 rtb_surface_draw_children(struct rtb_surface *self)
 {
+	struct rtb_rect exposed[2];
 	struct rtb_element *iter;
+	int i, nexposed = 0;
 
 	GLint bound_fb;
 	GLint viewport[4];
@@ -185,9 +449,26 @@ rtb_surface_draw_children(struct rtb_surface *self)
 	if (!rtb_surface_is_dirty(self))
 		return;
 
+	/* whatever has been damaged up until now is about to be redrawn. */
+	rtb_damage_clear(&self->damage);
+
+	/* anything batched up for the surface we're drawn into has to land
+	 * before we switch framebuffers out from under it. */
+	rtb_render_flush(rtb_render_get_context(RTB_ELEMENT(self)));
+
 	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &bound_fb);
 	glGetIntegerv(GL_VIEWPORT, viewport);
 
+	if (self->surface_state == RTB_SURFACE_VALID) {
+		nexposed = move_contents(self, exposed);
+
+		if (nexposed < 0)
+			self->surface_state = RTB_SURFACE_INVALID;
+	} else {
+		self->pending_scroll.x = 0.f;
+		self->pending_scroll.y = 0.f;
+	}
+
 	glBindFramebuffer(GL_FRAMEBUFFER, self->fbo);
 	glViewport(0, 0, self->w, self->h);
 
@@ -210,6 +491,8 @@ rtb_surface_draw_children(struct rtb_surface *self)
 
 			iter->render_entry.tqe_next = NULL;
 			iter->render_entry.tqe_prev = NULL;
+
+			self->window->frame_stats.render_queue_length++;
 		}
 
 		/* then we draw all the children. */
@@ -221,27 +504,111 @@ rtb_surface_draw_children(struct rtb_surface *self)
 
 	case RTB_SURFACE_VALID:
 		/* if we're marked valid, we'll just do an incremental redraw
-		 * just of the elements which have requested it. */
+		 * just of the elements which have requested it, plus whatever
+		 * has just been scrolled into view. */
+		for (i = 0; i < nexposed; i++)
+			draw_exposed(self, &exposed[i]);
+
 		while ((iter = TAILQ_FIRST(&self->render_queue))) {
 			TAILQ_REMOVE(&self->render_queue, iter, render_entry);
 
 			iter->render_entry.tqe_next = NULL;
 			iter->render_entry.tqe_prev = NULL;
 
+			self->window->frame_stats.render_queue_length++;
+
+			/* queued before an ancestor was, which is still waiting
+			 * further down the queue and will redraw this too. */
+			if (rtb_elem_has_queued_ancestor(iter)) {
+				self->window->frame_stats.coalesced_redraws++;
+				continue;
+			}
+
 			rtb_elem_draw(iter, 1);
 		}
 
 		break;
 	}
 
+	rtb_render_flush(&self->render_ctx);
+
 	glBindFramebuffer(GL_FRAMEBUFFER, bound_fb);
 	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
 }
 
+void
+rtb_surface_view_rect(struct rtb_surface *self, struct rtb_rect *view)
+{
+	view->x  = self->x  + self->scroll.x;
+	view->y  = self->y  + self->scroll.y;
+	view->x2 = self->x2 + self->scroll.x;
+	view->y2 = self->y2 + self->scroll.y;
+
+	rtb_rect_update_size_from_points(view);
+}
+
+/* `point` goes in in window coordinates and comes out in the content
+ * coordinates of `self`. */
+void
+rtb_surface_to_content(struct rtb_surface *self, struct rtb_point *point)
+{
+	for (; self && RTB_ELEMENT(self->surface) != RTB_ELEMENT(self);
+			self = self->surface) {
+		point->x += self->scroll.x;
+		point->y += self->scroll.y;
+	}
+}
+
+/* moves the content without laying any of it out again. what's already
+ * been drawn gets reused, and only the part that comes into view is drawn
+ * from scratch. */
+void
+rtb_surface_scroll_to(struct rtb_surface *self, float x, float y)
+{
+	struct rtb_element *iter;
+	struct rtb_rect view;
+
+	/* the window's framebuffer is the one we present, so it stays put. */
+	if (RTB_ELEMENT(self->surface) == RTB_ELEMENT(self))
+		return;
+
+	/* whole pixels only, so that what we move lines up exactly. */
+	x = roundf(x);
+	y = roundf(y);
+
+	if (x == self->scroll.x && y == self->scroll.y)
+		return;
+
+	self->pending_scroll.x += x - self->scroll.x;
+	self->pending_scroll.y += y - self->scroll.y;
+	self->scroll.x = x;
+	self->scroll.y = y;
+
+	set_projection(self);
+
+	TAILQ_FOREACH(iter, &self->children, child)
+		rtb_elem_update_visibility(iter);
+
+	rtb_surface_view_rect(self, &view);
+	rtb_surface_damage(self, &view);
+	rtb_elem_mark_dirty(RTB_ELEMENT(self));
+}
+
+void
+rtb_surface_scroll_by(struct rtb_surface *self, float dx, float dy)
+{
+	rtb_surface_scroll_to(self, self->scroll.x + dx, self->scroll.y + dy);
+}
+
 void
 rtb_surface_invalidate(struct rtb_surface *self)
 {
+	struct rtb_rect view;
+
+	rtb_surface_view_rect(self, &view);
+
 	self->surface_state = RTB_SURFACE_INVALID;
+	rtb_surface_damage(self, &view);
 	rtb_elem_mark_dirty(RTB_ELEMENT(self));
 }
 
@@ -259,11 +626,22 @@ rtb_surface_init(struct rtb_surface *self)
 	self->impl.child_attached = child_attached;
 
 	TAILQ_INIT(&self->render_queue);
+	rtb_damage_clear(&self->damage);
+
+	if (rtb_render_context_init(&self->render_ctx, self))
+		return -1;
 
 	glGenTextures(1, &self->texture);
 	glGenFramebuffers(1, &self->fbo);
 	rtb_quad_init(&self->quad);
 
+	self->scroll.x = 0.f;
+	self->scroll.y = 0.f;
+	self->pending_scroll.x = 0.f;
+	self->pending_scroll.y = 0.f;
+	self->spare_fbo = 0;
+	self->spare_texture = 0;
+
 	self->surface_state = RTB_SURFACE_INVALID;
 
 	return 0;
@@ -273,9 +651,12 @@ void
 rtb_surface_fini(struct rtb_surface *self)
 {
 	rtb_quad_fini(&self->quad);
+	free_spare(self);
 
 	glDeleteFramebuffers(1, &self->fbo);
 	glDeleteTextures(1, &self->texture);
 
+	rtb_render_context_fini(&self->render_ctx);
+
 	rtb_elem_fini(RTB_ELEMENT(self));
 }
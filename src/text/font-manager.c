@@ -33,12 +33,37 @@
 #include "rutabaga/shader.h"
 
 #include "shaders/text.glsl.h"
+#include "shaders/text-sdf.glsl.h"
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
 
 #define ERR(...) fprintf(stderr, "rutabaga: " __VA_ARGS__)
 
+/* bytes of glyph atlas data, CPU-side and on the GPU each. */
+#define GLYPH_ATLAS_BUDGET (8 << 20)
+
+/* distance field glyphs are rasterised with an em this many pixels tall,
+ * and their fields reach this many pixels out from the outline. */
+#define DISTANCE_FIELD_EM     32
+#define DISTANCE_FIELD_SPREAD 4
+
+struct rtb_distance_field_face {
+	texture_font_t *txfont;
+	int refcount;
+
+	struct rtb_distance_field_face *next;
+};
+
+/* a font's default glyphs, rasterised on the prewarm thread. `bitmaps`
+ * stays NULL until then, or if that ran out of memory. */
+struct rtb_glyph_prewarm {
+	texture_font_t *txfont;
+	vector_t *bitmaps;
+
+	struct rtb_glyph_prewarm *next;
+};
+
 static const uint8_t lcd_weights[] = {
 	0x00,
 	0x55,
@@ -56,19 +81,299 @@ static const rtb_utf32_t cache[] = {
 	' ', ',', '.', '!', '?', ';', '[', '\\', ']', '^', '_', '@', '{', '|', '}', '~', '\"', '#', '$', '%', '&', '\'', '(', ')',
 	'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z',
 	'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O', 'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z',
-	'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '*', '+', '-', '/', ':', '<', '=', '>', '`'
+	'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '*', '+', '-', '/', ':', '<', '=', '>', '`',
+	0
 };
 
+/**
+ * prewarming
+ *
+ * rasterising every font's `cache` up front used to hold up the first
+ * frame. the prewarm thread does it instead, and the glyphs go into the
+ * atlas on the main thread once they're ready. text drawn before then
+ * rasterises just the glyphs it needs, through texture_font_get_glyph().
+ */
+
+static void
+free_jobs(struct rtb_glyph_prewarm **list, const texture_font_t *txfont)
+{
+	struct rtb_glyph_prewarm *job;
+
+	while ((job = *list)) {
+		if (txfont && job->txfont != txfont) {
+			list = &job->next;
+			continue;
+		}
+
+		*list = job->next;
+
+		if (job->bitmaps)
+			texture_glyph_bitmaps_delete(job->bitmaps);
+		free(job);
+	}
+}
+
+static void
+prewarm_thread(void *ctx)
+{
+	struct rtb_font_manager *fm = ctx;
+	struct rtb_glyph_prewarm *job;
+	vector_t *bitmaps;
+
+	uv_mutex_lock(&fm->prewarm.lock);
+
+	while ((job = fm->prewarm.queue)) {
+		fm->prewarm.queue = job->next;
+		fm->prewarm.job = job;
+		uv_mutex_unlock(&fm->prewarm.lock);
+
+		bitmaps = texture_font_rasterize_glyphs(job->txfont, cache);
+
+		uv_mutex_lock(&fm->prewarm.lock);
+		job->bitmaps = bitmaps;
+		job->next = fm->prewarm.done;
+		fm->prewarm.done = job;
+
+		fm->prewarm.job = NULL;
+		uv_cond_broadcast(&fm->prewarm.job_done);
+	}
+
+	/* anything queued from here on needs a new thread. */
+	fm->prewarm.thread_exiting = 1;
+	uv_mutex_unlock(&fm->prewarm.lock);
+}
+
+static void
+prewarm_font(struct rtb_font_manager *fm, texture_font_t *txfont)
+{
+	struct rtb_glyph_prewarm *job, **tail;
+	int start_thread;
+
+	if (!(job = calloc(1, sizeof(*job)))) {
+		texture_font_load_glyphs(txfont, cache);
+		return;
+	}
+
+	job->txfont = txfont;
+
+	uv_mutex_lock(&fm->prewarm.lock);
+
+	for (tail = &fm->prewarm.queue; *tail; tail = &(*tail)->next);
+	*tail = job;
+
+	start_thread = !fm->prewarm.thread_started || fm->prewarm.thread_exiting;
+	uv_mutex_unlock(&fm->prewarm.lock);
+
+	if (!start_thread)
+		return;
+
+	if (fm->prewarm.thread_started)
+		uv_thread_join(&fm->prewarm.thread);
+
+	fm->prewarm.thread_exiting = 0;
+	fm->prewarm.thread_started =
+		!uv_thread_create(&fm->prewarm.thread, prewarm_thread, fm);
+
+	if (fm->prewarm.thread_started)
+		return;
+
+	/* no thread to be had, so everything queued gets done right here. */
+	uv_mutex_lock(&fm->prewarm.lock);
+	job = fm->prewarm.queue;
+	fm->prewarm.queue = NULL;
+	uv_mutex_unlock(&fm->prewarm.lock);
+
+	for (tail = &job; *tail; tail = &(*tail)->next)
+		texture_font_load_glyphs((*tail)->txfont, cache);
+
+	free_jobs(&job, NULL);
+}
+
+/* the prewarm thread has to be done with a font before it's deleted. */
+static void
+prewarm_cancel(struct rtb_font_manager *fm, const texture_font_t *txfont)
+{
+	uv_mutex_lock(&fm->prewarm.lock);
+
+	free_jobs(&fm->prewarm.queue, txfont);
+
+	while (fm->prewarm.job && fm->prewarm.job->txfont == txfont)
+		uv_cond_wait(&fm->prewarm.job_done, &fm->prewarm.lock);
+
+	free_jobs(&fm->prewarm.done, txfont);
+
+	uv_mutex_unlock(&fm->prewarm.lock);
+}
+
+static int
+prewarm_init(struct rtb_font_manager *fm)
+{
+	if (uv_mutex_init(&fm->prewarm.lock))
+		return -1;
+
+	if (uv_cond_init(&fm->prewarm.job_done)) {
+		uv_mutex_destroy(&fm->prewarm.lock);
+		return -1;
+	}
+
+	fm->prewarm.thread_started = 0;
+	fm->prewarm.thread_exiting = 0;
+
+	fm->prewarm.queue = NULL;
+	fm->prewarm.job = NULL;
+	fm->prewarm.done = NULL;
+
+	return 0;
+}
+
+static void
+prewarm_fini(struct rtb_font_manager *fm)
+{
+	uv_mutex_lock(&fm->prewarm.lock);
+
+	free_jobs(&fm->prewarm.queue, NULL);
+
+	while (fm->prewarm.job)
+		uv_cond_wait(&fm->prewarm.job_done, &fm->prewarm.lock);
+
+	uv_mutex_unlock(&fm->prewarm.lock);
+
+	if (fm->prewarm.thread_started)
+		uv_thread_join(&fm->prewarm.thread);
+
+	free_jobs(&fm->prewarm.done, NULL);
+
+	uv_cond_destroy(&fm->prewarm.job_done);
+	uv_mutex_destroy(&fm->prewarm.lock);
+}
+
 static int
 init_font(struct rtb_font *font)
 {
 	if (0)
 		memcpy(font->txfont->lcd_weights, lcd_weights, sizeof(lcd_weights));
 
-	texture_font_load_glyphs(font->txfont, cache);
+	font->distance_field = 0;
+	font->scale = 1.f;
+
+	prewarm_font(font->fm, font->txfont);
+	return 0;
+}
+
+/**
+ * distance field faces
+ */
+
+static struct rtb_distance_field_face *
+find_face(struct rtb_font_manager *fm, const void *base, const char *path)
+{
+	struct rtb_distance_field_face *face;
+	texture_font_t *txfont;
+
+	for (face = fm->distance_field.faces; face; face = face->next) {
+		txfont = face->txfont;
+
+		if (base && txfont->location == TEXTURE_FONT_MEMORY
+				&& txfont->memory.base == base)
+			return face;
+
+		if (path && txfont->location == TEXTURE_FONT_FILE
+				&& !strcmp(txfont->filename, path))
+			return face;
+	}
+
+	return NULL;
+}
+
+/* exactly one of `base` and `path` is non-NULL. */
+static int
+load_distance_field_font(struct rtb_font_manager *fm, struct rtb_font *font,
+		int pt_size, const void *base, size_t size, const char *path)
+{
+	texture_atlas_t *atlas = fm->distance_field.atlas;
+	struct rtb_distance_field_face *face;
+	float em_size;
+
+	/* made on first use, at the same dpi as the bitmap glyphs. a distance
+	 * field scales, so only ever needs the one channel. */
+	if (!atlas) {
+		atlas = texture_atlas_new(512, 512, 1,
+				fm->atlas->dpi.x, fm->atlas->dpi.y);
+		if (!atlas)
+			return -1;
+
+		atlas->budget = GLYPH_ATLAS_BUDGET;
+		fm->distance_field.atlas = atlas;
+	}
+
+	em_size = DISTANCE_FIELD_EM * 72.f / atlas->dpi.y;
+	face = find_face(fm, base, path);
+
+	if (!face) {
+		if (!(face = calloc(1, sizeof(*face))))
+			return -1;
+
+		if (base)
+			face->txfont =
+				texture_font_new_from_memory(atlas, em_size, base, size);
+		else
+			face->txfont = texture_font_new_from_file(atlas, em_size, path);
+
+		if (!face->txfont) {
+			free(face);
+			return -1;
+		}
+
+		/* hinting snaps outlines to the pixel grid of the size they're
+		 * rasterised at, which is the wrong grid at any other size. */
+		face->txfont->distance_field = DISTANCE_FIELD_SPREAD;
+		face->txfont->hinting = 0;
+		prewarm_font(fm, face->txfont);
+
+		face->next = fm->distance_field.faces;
+		fm->distance_field.faces = face;
+	}
+
+	face->refcount++;
+
+	font->txfont = face->txfont;
+	font->distance_field = 1;
+	font->scale = pt_size / em_size;
 	return 0;
 }
 
+static void
+release_distance_field_font(struct rtb_font *font)
+{
+	struct rtb_distance_field_face *face, **prev;
+
+	for (prev = &font->fm->distance_field.faces; (face = *prev);
+			prev = &face->next) {
+		if (face->txfont != font->txfont)
+			continue;
+
+		if (--face->refcount)
+			return;
+
+		*prev = face->next;
+		prewarm_cancel(font->fm, face->txfont);
+		texture_font_delete(face->txfont);
+		free(face);
+		return;
+	}
+}
+
+static void
+free_font(struct rtb_font *font)
+{
+	if (font->distance_field)
+		release_distance_field_font(font);
+	else {
+		prewarm_cancel(font->fm, font->txfont);
+		texture_font_delete(font->txfont);
+	}
+}
+
 /**
  * emebedded font
  */
@@ -77,6 +382,15 @@ int
 rtb_font_manager_load_embedded_font(struct rtb_font_manager *fm,
 		struct rtb_font *font, int pt_size, const void *base, size_t size)
 {
+	if (fm->distance_field.enabled) {
+		if (load_distance_field_font(fm, font, pt_size, base, size, NULL))
+			return -1;
+
+		font->size = pt_size;
+		font->fm   = fm;
+		return 0;
+	}
+
 	font->txfont =
 		texture_font_new_from_memory(fm->atlas, pt_size, base, size);
 
@@ -93,7 +407,7 @@ rtb_font_manager_load_embedded_font(struct rtb_font_manager *fm,
 void
 rtb_font_manager_free_embedded_font(struct rtb_font *font)
 {
-	texture_font_delete(font->txfont);
+	free_font(font);
 }
 
 /**
@@ -104,6 +418,19 @@ int
 rtb_font_manager_load_external_font(struct rtb_font_manager *fm,
 		struct rtb_external_font *font, int pt_size, const char *path)
 {
+	if (fm->distance_field.enabled) {
+		if (load_distance_field_font(fm, RTB_FONT(font),
+					pt_size, NULL, 0, path)) {
+			ERR("couldn't load font \"%s\"\n", path);
+			return -1;
+		}
+
+		font->path = strdup(path);
+		font->size = pt_size;
+		font->fm   = fm;
+		return 0;
+	}
+
 	font->txfont = texture_font_new_from_file(fm->atlas, pt_size, path);
 	if (!font->txfont) {
 		ERR("couldn't load font \"%s\"\n", path);
@@ -122,43 +449,122 @@ void
 rtb_font_manager_free_external_font(struct rtb_external_font *font)
 {
 	free(font->path);
-	texture_font_delete(font->txfont);
+	free_font(RTB_FONT(font));
 }
 
 int
-rtb_font_manager_init(struct rtb_font_manager *fm, int dpi_x, int dpi_y)
+rtb_font_manager_add_prewarmed_glyphs(struct rtb_font_manager *fm)
 {
-	if (!rtb_shader_create(RTB_SHADER(&fm->shader),
-				TEXT_VERT_SHADER, NULL, TEXT_FRAG_SHADER)) {
-		ERR("couldn't compile text shader.\n");
-		goto err_shader;
+	struct rtb_glyph_prewarm *job, *done;
+	int fonts = 0;
+
+	uv_mutex_lock(&fm->prewarm.lock);
+	done = fm->prewarm.done;
+	fm->prewarm.done = NULL;
+	uv_mutex_unlock(&fm->prewarm.lock);
+
+	for (job = done; job; job = job->next) {
+		if (!job->bitmaps)
+			texture_font_load_glyphs(job->txfont, cache);
+		else if (texture_font_add_glyphs(job->txfont, job->bitmaps))
+			fonts++;
 	}
 
+	free_jobs(&done, NULL);
+	return fonts;
+}
+
+void
+rtb_font_manager_use_distance_fields(struct rtb_font_manager *fm,
+		int enable)
+{
+	fm->distance_field.enabled = !!enable;
+}
+
+static int
+font_shader_create(struct rtb_font_shader *shader,
+		const char *vertex_src, const char *fragment_src)
+{
+	if (!rtb_shader_create(RTB_SHADER(shader),
+				vertex_src, NULL, fragment_src))
+		return -1;
+
 #define CACHE_UNIFORM(UNIFORM) \
-	fm->shader.UNIFORM = glGetUniformLocation(fm->shader.program, #UNIFORM)
+	shader->UNIFORM = glGetUniformLocation(shader->program, #UNIFORM)
 
-	CACHE_UNIFORM(offset);
 	CACHE_UNIFORM(texture);
 	CACHE_UNIFORM(atlas_pixel);
 	CACHE_UNIFORM(gamma);
 
 #undef CACHE_UNIFORM
 
+#define CACHE_ATTRIBUTE(ATTRIBUTE) \
+	shader->ATTRIBUTE = glGetAttribLocation(shader->program, #ATTRIBUTE)
+
+	CACHE_ATTRIBUTE(subpixel_shift);
+	CACHE_ATTRIBUTE(vertex_color);
+
+#undef CACHE_ATTRIBUTE
+
+	return 0;
+}
+
+int
+rtb_font_manager_init(struct rtb_font_manager *fm, int dpi_x, int dpi_y)
+{
+	if (prewarm_init(fm)) {
+		ERR("couldn't set up glyph prewarming.\n");
+		goto err_prewarm;
+	}
+
+	if (font_shader_create(&fm->shader,
+				TEXT_VERT_SHADER, TEXT_FRAG_SHADER)) {
+		ERR("couldn't compile text shader.\n");
+		goto err_shader;
+	}
+
+	if (font_shader_create(&fm->distance_field.shader,
+				TEXT_SDF_VERT_SHADER, TEXT_SDF_FRAG_SHADER)) {
+		ERR("couldn't compile distance field text shader.\n");
+		goto err_distance_field_shader;
+	}
+
 #ifdef FT_CONFIG_OPTION_SUBPIXEL_RENDERING
 	fm->atlas = texture_atlas_new(512, 512, 3, dpi_x, dpi_y);
 #else
 	fm->atlas = texture_atlas_new(512, 512, 1, dpi_x, dpi_y);
 #endif
 
+	/* the atlas starts small and doubles as glyphs are loaded. past the
+	 * budget, the least recently used glyphs get evicted instead. */
+	fm->atlas->budget = GLYPH_ATLAS_BUDGET;
+
+	fm->distance_field.atlas = NULL;
+	fm->distance_field.faces = NULL;
+	fm->distance_field.enabled = 0;
+
+	memset(fm->runs, 0, sizeof(fm->runs));
+
 	return 0;
 
+err_distance_field_shader:
+	rtb_shader_free(RTB_SHADER(&fm->shader));
 err_shader:
+	prewarm_fini(fm);
+err_prewarm:
 	return -1;
 }
 
 void
 rtb_font_manager_fini(struct rtb_font_manager *fm)
 {
+	prewarm_fini(fm);
+
+	if (fm->distance_field.atlas)
+		texture_atlas_delete(fm->distance_field.atlas);
+
+	rtb_shader_free(RTB_SHADER(&fm->distance_field.shader));
+
 	texture_atlas_delete(fm->atlas);
 	rtb_shader_free(RTB_SHADER(&fm->shader));
 }
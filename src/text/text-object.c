@@ -25,6 +25,8 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 
 #include "rutabaga/rutabaga.h"
 #include "rutabaga/element.h"
@@ -37,36 +39,27 @@
 #include "rutabaga/text-object.h"
 
 #include "freetype-gl/freetype-gl.h"
-#include "freetype-gl/vertex-buffer.h"
 
 #include "rtb_private/utf8.h"
+#include "rtb_private/util.h"
+#include "rtb_private/stdlib-allocator.h"
 
-struct text_vertex {
-	float x, y;
-	float s, t;
-	float shift;
-};
-
+/* `idx` counts from 1. */
 int
 rtb_text_object_get_glyph_rect(struct rtb_text_object *self, int idx,
 		struct rtb_rect *rect)
 {
-	vector_t *vertices = self->vertices->vertices;
-	struct text_vertex *v;
+	struct rtb_text_glyph *glyph;
 
-	if (idx < 0 || ((size_t) idx * 4) > vector_size(vertices))
+	if (!self->run || idx < 1 || (size_t) idx > self->run->glyphs.size)
 		return -1;
 
-	v = (void *) vector_get(vertices, (idx * 4) - 4);
-
-	/* upper left corner */
-	rect->x = v->x;
-	rect->y = v->y;
+	glyph = &self->run->glyphs.data[idx - 1];
 
-	/* lower right corner */
-	v += 2;
-	rect->x2 = v->x;
-	rect->y2 = v->y;
+	rect->x  = glyph->x0;
+	rect->y  = glyph->y0;
+	rect->x2 = glyph->x1;
+	rect->y2 = glyph->y1;
 
 	return 0;
 }
@@ -74,130 +67,468 @@ rtb_text_object_get_glyph_rect(struct rtb_text_object *self, int idx,
 int
 rtb_text_object_count_glyphs(struct rtb_text_object *self)
 {
-	return vector_size(self->vertices->vertices) / 4;
+	if (!self->run)
+		return 0;
+
+	return self->run->glyphs.size;
 }
 
-int
-rtb_text_object_update(struct rtb_text_object *self,
-		struct rtb_font *rfont, const rtb_utf8_t *text)
+/**
+ * text runs
+ */
+
+/* decodes the codepoint at `*text` and steps past it. malformed
+ * sequences come out as U+FFFD. returns 0 at the end of the string. */
+static int
+next_codepoint(const rtb_utf8_t **text, rtb_utf32_t *codepoint)
 {
-	rtb_utf32_t codepoint, prev_codepoint;
 	uint32_t state, prev_state;
-	texture_font_t *font;
-	float x0, y0, x1, y1;
-	float x, y;
 
-	if (!rfont || !text)
-		return -1;
+	state = prev_state = UTF8_ACCEPT;
 
-	font = rfont->txfont;
-	self->font = rfont;
+	for (; **text; prev_state = state, (*text)++) {
+		switch(u8dec(&state, codepoint, **text)) {
+		case UTF8_ACCEPT:
+			(*text)++;
+			return 1;
 
-	vertex_buffer_clear(self->vertices);
+		case UTF8_REJECT:
+			/* the byte that broke the sequence may start the next one. */
+			if (prev_state == UTF8_ACCEPT)
+				(*text)++;
 
-	x  = 0.f;
-	x1 = 0.f;
-	y  = ceilf(font->height / 2.f) - font->descender + 1.f;
+			*codepoint = 0xFFFD;
+			return 1;
 
-	state = prev_state = UTF8_ACCEPT;
-	prev_codepoint = 0;
+		default:
+			continue;
+		}
+	}
 
-	for (; *text; prev_state = state, text++) {
-		texture_glyph_t *glyph;
-		float s0, t0, s1, t1, x0_shift, x1_shift;
+	return 0;
+}
 
-		switch(u8dec(&state, &codepoint, *text)) {
-		case UTF8_ACCEPT:
-			break;
+#define MISSING_GLYPH_BATCH 64
 
-		case UTF8_REJECT:
-			if (prev_state != UTF8_ACCEPT)
-				text--;
+/* glyphs that the font hasn't got yet (because prewarming hasn't finished,
+ * or never covered them) are rasterised in batches rather than one
+ * FreeType session apiece through texture_font_get_glyph(). */
+static void
+load_missing_glyphs(texture_font_t *font, const rtb_utf8_t *text)
+{
+	int32_t missing[MISSING_GLYPH_BATCH + 1];
+	rtb_utf32_t codepoint;
+	int i, count;
 
-			codepoint = 0xFFFD;
-			state = UTF8_ACCEPT;
-			break;
+	count = 0;
 
-		default:
+	while (next_codepoint(&text, &codepoint)) {
+		if (texture_font_find_glyph(font, codepoint))
+			continue;
+
+		for (i = 0; i < count; i++)
+			if (missing[i] == (int32_t) codepoint)
+				break;
+
+		if (i < count)
 			continue;
+
+		missing[count++] = codepoint;
+
+		if (count == MISSING_GLYPH_BATCH) {
+			missing[count] = 0;
+			texture_font_load_glyphs(font, missing);
+			count = 0;
 		}
+	}
+
+	if (count) {
+		missing[count] = 0;
+		texture_font_load_glyphs(font, missing);
+	}
+}
+
+/* bitmap glyphs are snapped to whole pixels and the remainder is left to
+ * the shader's subpixel shift. distance field glyphs are scaled from the
+ * size they were rasterised at and go wherever they land. */
+static void
+layout(struct rtb_text_run *run, const struct rtb_font *rfont,
+		const rtb_utf8_t *text)
+{
+	texture_font_t *font = rfont->txfont;
+	rtb_utf32_t codepoint, prev_codepoint;
+	float x0, y0, x1, y1;
+	float x, y, scale;
+
+	VECTOR_CLEAR(&run->glyphs);
+
+	scale = rfont->scale;
+
+	x  = 0.f;
+	x1 = 0.f;
+	y  = ceilf(font->height * scale / 2.f) - font->descender * scale + 1.f;
+
+	load_missing_glyphs(font, text);
+	prev_codepoint = 0;
+
+	while (next_codepoint(&text, &codepoint)) {
+		struct rtb_text_glyph quad;
+		texture_glyph_t *glyph;
 
 		glyph = texture_font_get_glyph(font, codepoint);
 		if (!glyph)
 			continue;
 
 		if (prev_codepoint)
-			x += texture_glyph_get_kerning(glyph, prev_codepoint);
+			x += texture_glyph_get_kerning(glyph, prev_codepoint) * scale;
+
+		x0 = x  + glyph->offset_x * scale;
+		y0 = y  - glyph->offset_y * scale;
+		x1 = x0 + glyph->width  * scale;
+		y1 = y0 + glyph->height * scale;
+
+		if (rfont->distance_field)
+			quad = (struct rtb_text_glyph) {
+				.x0 = x0,
+				.y0 = y0,
+				.x1 = x1,
+				.y1 = y1,
+
+				.s0 = glyph->s0,
+				.t0 = glyph->t0,
+				.s1 = glyph->s1,
+				.t1 = glyph->t1
+			};
+		else
+			quad = (struct rtb_text_glyph) {
+				.x0 = floorf(x0),
+				.y0 = y0,
+				.x1 = floorf(x1),
+				.y1 = y1,
+
+				.s0 = glyph->s0,
+				.t0 = glyph->t0,
+				.s1 = glyph->s1,
+				.t1 = glyph->t1,
+
+				.shift0 = x0 - floorf(x0),
+				.shift1 = x1 - floorf(x1)
+			};
+
+		VECTOR_PUSH_BACK(&run->glyphs, &quad);
+
+		x += glyph->advance_x * scale;
+		prev_codepoint = codepoint;
+	}
 
-		x0 = x  + glyph->offset_x;
-		y0 = y  - glyph->offset_y;
-		x1 = x0 + glyph->width;
-		y1 = y0 + glyph->height;
+	run->h = font->height * scale;
+	run->w = roundf(x);
+}
 
-		s0 = glyph->s0;
-		s1 = glyph->s1;
+static void
+run_layout(struct rtb_text_run *run)
+{
+	texture_atlas_t *atlas = run->font->txfont->atlas;
 
-		t0 = glyph->t0;
-		t1 = glyph->t1;
+	run->atlas_generation = atlas->generation;
+	layout(run, run->font, run->text);
+
+	/* loading glyphs for this text can make the atlas grow or evict,
+	 * which moves the glyphs laid out before it happened. once more is
+	 * enough, since everything in the text is now the most recently used. */
+	if (run->atlas_generation != atlas->generation) {
+		run->atlas_generation = atlas->generation;
+		layout(run, run->font, run->text);
+	}
+}
 
-		x0_shift = x0 - floorf(x0);
-		x1_shift = x1 - floorf(x1);
+static int
+run_is_stale(const struct rtb_text_run *run)
+{
+	return run->atlas_generation != run->font->txfont->atlas->generation;
+}
 
-		x0 = floorf(x0);
-		x1 = floorf(x1);
+/* FNV-1a over the text, seeded with the font. */
+static uint32_t
+run_hash(const struct rtb_font *font, const rtb_utf8_t *text)
+{
+	uint32_t hash = 2166136261u ^ (uint32_t) (uintptr_t) font;
 
-		GLuint indices[6] = {0, 1, 2, 0, 2, 3};
-		struct text_vertex vertices[4] = {
-			{x0, y0, s0, t0, x0_shift},
-			{x0, y1, s0, t1, x0_shift},
-			{x1, y1, s1, t1, x1_shift},
-			{x1, y0, s1, t0, x1_shift}
-		};
+	for (; *text; text++)
+		hash = (hash ^ (uint8_t) *text) * 16777619u;
 
-		vertex_buffer_push_back(self->vertices, vertices, 4, indices, 6);
+	return hash;
+}
 
-		x += glyph->advance_x;
-		prev_codepoint = codepoint;
+static struct rtb_text_run **
+run_bucket(struct rtb_font_manager *fm, uint32_t hash)
+{
+	return &fm->runs[hash % RTB_TEXT_RUN_BUCKETS];
+}
+
+static struct rtb_text_run *
+run_find(struct rtb_font_manager *fm, const struct rtb_font *font,
+		const rtb_utf8_t *text, uint32_t hash)
+{
+	struct rtb_text_run *run;
+
+	for (run = *run_bucket(fm, hash); run; run = run->next)
+		if (run->hash == hash && run->font == font
+				&& !strcmp(run->text, text))
+			return run;
+
+	return NULL;
+}
+
+static void
+run_link(struct rtb_font_manager *fm, struct rtb_text_run *run)
+{
+	struct rtb_text_run **bucket = run_bucket(fm, run->hash);
+
+	run->next = *bucket;
+	*bucket = run;
+}
+
+static void
+run_unlink(struct rtb_font_manager *fm, struct rtb_text_run *run)
+{
+	struct rtb_text_run **link = run_bucket(fm, run->hash);
+
+	for (; *link; link = &(*link)->next) {
+		if (*link == run) {
+			*link = run->next;
+			return;
+		}
+	}
+}
+
+static struct rtb_text_run *
+run_new(struct rtb_font *font, const rtb_utf8_t *text, uint32_t hash)
+{
+	struct rtb_text_run *run = calloc(1, sizeof(*run));
+
+	if (!run)
+		return NULL;
+
+	if (!(run->text = strdup(text))) {
+		free(run);
+		return NULL;
 	}
 
-	vertex_buffer_upload(self->vertices);
-	self->h = font->height;
-	self->w = roundf(x);
+	VECTOR_INIT(&run->glyphs, &stdlib_allocator, 16);
+	run->font = font;
+	run->hash = hash;
+	run->refcount = 1;
+
+	run_layout(run);
+	return run;
+}
+
+static void
+run_release(struct rtb_font_manager *fm, struct rtb_text_run *run)
+{
+	if (--run->refcount)
+		return;
+
+	run_unlink(fm, run);
+	VECTOR_FREE(&run->glyphs);
+	free(run->text);
+	free(run);
+}
+
+/* points `run` at different text. only valid for a run nothing else is
+ * using, and saves freeing it and allocating a new one: its glyph vector
+ * is laid out again in place, keeping whatever capacity it had. */
+static int
+run_retarget(struct rtb_font_manager *fm, struct rtb_text_run *run,
+		struct rtb_font *font, const rtb_utf8_t *text, uint32_t hash)
+{
+	rtb_utf8_t *copy;
+
+	if (!(copy = strdup(text)))
+		return -1;
+
+	run_unlink(fm, run);
 
+	free(run->text);
+	run->text = copy;
+	run->font = font;
+	run->hash = hash;
+
+	run_layout(run);
+	run_link(fm, run);
 	return 0;
 }
 
+/**
+ * public API
+ */
+
+int
+rtb_text_object_update(struct rtb_text_object *self,
+		struct rtb_font *rfont, const rtb_utf8_t *text)
+{
+	struct rtb_text_run *run, *shared;
+	uint32_t hash;
+
+	if (!rfont || !text)
+		return -1;
+
+	run = self->run;
+
+	/* same text as last time: nothing to lay out or upload. */
+	if (run && run->font == rfont && !strcmp(run->text, text)) {
+		if (run_is_stale(run))
+			run_layout(run);
+
+		goto out;
+	}
+
+	hash = run_hash(rfont, text);
+
+	if ((shared = run_find(self->fm, rfont, text, hash))) {
+		shared->refcount++;
+
+		if (run_is_stale(shared))
+			run_layout(shared);
+
+		if (run)
+			run_release(self->fm, run);
+
+		run = shared;
+	} else if (run && run->refcount == 1) {
+		if (run_retarget(self->fm, run, rfont, text, hash))
+			return -1;
+	} else {
+		if (!(shared = run_new(rfont, text, hash)))
+			return -1;
+
+		run_link(self->fm, shared);
+
+		if (run)
+			run_release(self->fm, run);
+
+		run = shared;
+	}
+
+out:
+	self->run  = run;
+	self->font = rfont;
+	self->w = run->w;
+	self->h = run->h;
+	return 0;
+}
+
+/* appends the glyphs of the run to the render context's text batch,
+ * offset by `x`, `y` and clipped to the element drawing them, which is
+ * what the scissor would have done if they were drawn on their own. */
 void
 rtb_text_object_render(struct rtb_text_object *self,
 		struct rtb_render_context *ctx, float x, float y,
 		const struct rtb_rgb_color *color)
 {
-	struct rtb_font_shader *shader;
-	struct rtb_font_manager *fm;
-	texture_atlas_t *atlas;
-
-	if (!vertex_buffer_size(self->vertices))
+	struct rtb_text_vertex *v, *start;
+	struct rtb_text_glyph *glyph;
+	struct rtb_text_run *run;
+	struct rtb_rect clip, area;
+	size_t i;
+
+	run = self->run;
+	if (!run || !run->glyphs.size)
 		return;
 
-	fm = self->fm;
-	shader = &fm->shader;
-	atlas = fm->atlas;
+	/* laying out again can grow or evict glyphs in the atlas that the
+	 * batch shares with other text, which would leave the texture
+	 * coordinates of whatever's already in it pointing at the wrong
+	 * glyphs, so draw that first. */
+	if (run_is_stale(run)) {
+		rtb_render_flush(ctx);
+		run_layout(run);
+	}
+
+	/* rounded the same way rtb_render_scissor() rounds, which flips y. */
+	if (ctx->target) {
+		clip.x  = floorf(ctx->target->x);
+		clip.y  = ceilf(ctx->target->y);
+		clip.x2 = floorf(ctx->target->x2);
+		clip.y2 = ceilf(ctx->target->y2);
+	} else {
+		clip.x  = clip.y  = -INFINITY;
+		clip.x2 = clip.y2 =  INFINITY;
+	}
+
+	area.x  = MAX(x, clip.x);
+	area.y  = MAX(y, clip.y);
+	area.x2 = MIN(x + run->w, clip.x2);
+	area.y2 = MIN(y + run->h, clip.y2);
 
-	rtb_render_use_shader(ctx, RTB_SHADER(shader));
-	glBindTexture(GL_TEXTURE_2D, atlas->id);
+	start = v = rtb_render_text_reserve(ctx, self->font,
+			run->glyphs.size * 6);
 
-	glUniform1i(shader->texture, 0);
-	glUniform1f(shader->gamma, self->font->lcd_gamma);
+	for (i = 0; i < run->glyphs.size; i++) {
+		GLfloat x0, y0, x1, y1, s0, t0, s1, t1, shift0, shift1, f;
 
-	glUniform3f(shader->atlas_pixel,
-			1.f / atlas->width, 1.f / atlas->height, atlas->depth);
+		glyph = &run->glyphs.data[i];
 
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		x0 = x + glyph->x0;
+		y0 = y + glyph->y0;
+		x1 = x + glyph->x1;
+		y1 = y + glyph->y1;
 
-	glUniform2f(shader->offset, x, y);
-	rtb_render_set_color(ctx,
-			color->r, color->g, color->b, color->a);
-	vertex_buffer_render(self->vertices, GL_TRIANGLES);
+		if (x0 >= clip.x2 || x1 <= clip.x || y0 >= clip.y2 || y1 <= clip.y)
+			continue;
+
+		s0 = glyph->s0;
+		t0 = glyph->t0;
+		s1 = glyph->s1;
+		t1 = glyph->t1;
+		shift0 = glyph->shift0;
+		shift1 = glyph->shift1;
+
+		/* cut the quad down to the clip, moving its texture coordinates
+		 * and subpixel shift along with it. */
+		if (x0 < clip.x) {
+			f = (clip.x - x0) / (x1 - x0);
+			s0 += (s1 - s0) * f;
+			shift0 += (shift1 - shift0) * f;
+			x0 = clip.x;
+		}
+
+		if (x1 > clip.x2) {
+			f = (x1 - clip.x2) / (x1 - x0);
+			s1 -= (s1 - s0) * f;
+			shift1 -= (shift1 - shift0) * f;
+			x1 = clip.x2;
+		}
+
+		if (y0 < clip.y) {
+			t0 += (t1 - t0) * (clip.y - y0) / (y1 - y0);
+			y0 = clip.y;
+		}
+
+		if (y1 > clip.y2) {
+			t1 -= (t1 - t0) * (y1 - clip.y2) / (y1 - y0);
+			y1 = clip.y2;
+		}
+
+#define VERTEX(X, Y, S, T, SHIFT) \
+		*v++ = (struct rtb_text_vertex) {               \
+			X, Y, S, T, SHIFT,                          \
+			color->r, color->g, color->b, color->a      \
+		}
+
+		VERTEX(x0, y0, s0, t0, shift0);
+		VERTEX(x0, y1, s0, t1, shift0);
+		VERTEX(x1, y1, s1, t1, shift1);
+
+		VERTEX(x0, y0, s0, t0, shift0);
+		VERTEX(x1, y1, s1, t1, shift1);
+		VERTEX(x1, y0, s1, t0, shift1);
+
+#undef VERTEX
+	}
+
+	rtb_render_text_commit(ctx, &area, v - start);
 }
 
 struct rtb_text_object *
@@ -206,14 +537,14 @@ rtb_text_object_new(struct rtb_font_manager *fm)
 	struct rtb_text_object *self = calloc(1, sizeof(*self));
 
 	self->fm = fm;
-	self->vertices = vertex_buffer_new("vertex:2f,tex_coord:2f,subpixel_shift:1f");
-
 	return self;
 }
 
 void
 rtb_text_object_free(struct rtb_text_object *self)
 {
-	vertex_buffer_delete(self->vertices);
+	if (self->run)
+		run_release(self->fm, self->run);
+
 	free(self);
 }
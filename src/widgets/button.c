@@ -54,6 +54,7 @@ dispatch_click_event(struct rtb_button *self, const struct rtb_mouse_event *e)
 	struct rtb_button_event event = *((struct rtb_button_event *) e);
 
 	event.type = RTB_BUTTON_CLICK;
+	rtb_surface_to_content(self->surface, &event.cursor);
 	event.cursor.x -= self->x;
 	event.cursor.y -= self->y;
 
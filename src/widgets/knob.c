@@ -101,11 +101,13 @@ restyle(struct rtb_element *elem)
 	const struct rtb_style_property_definition *prop;
 	super.restyle(elem);
 
-	prop = rtb_style_query_prop(elem,
-			"-rtb-knob-rotor", RTB_STYLE_PROP_TEXTURE, 0);
+	prop = rtb_style_query(elem,
+			RTB_STYLE_KEY_KNOB_ROTOR, RTB_STYLE_PROP_TEXTURE, 0);
 	if (prop &&
 			!rtb_stylequad_set_background_image(&self->rotor, &prop->texture))
 		rtb_elem_mark_dirty(elem);
+
+	rtb_stylequad_resolve_atlas(&self->rotor, &elem->window->style_atlas);
 }
 
 static int
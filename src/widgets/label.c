@@ -86,8 +86,8 @@ restyle(struct rtb_element *elem)
 
 	super.restyle(elem);
 
-	prop = rtb_style_query_prop_in_tree(self->parent,
-			"font", RTB_STYLE_PROP_FONT, 0);
+	prop = rtb_style_query_in_tree(self->parent,
+			RTB_STYLE_KEY_FONT, RTB_STYLE_PROP_FONT, 0);
 
 	assert(prop);
 
@@ -96,12 +96,11 @@ restyle(struct rtb_element *elem)
 		self->font = (struct rtb_font *) &prop->font.font_internal;
 
 		rtb_text_object_update(self->tobj, self->font, self->text);
-		rtb_elem_trigger_reflow(self->parent, RTB_ELEMENT(self),
-				RTB_DIRECTION_ROOTWARD);
+		rtb_elem_request_reflow(RTB_ELEMENT(self));
 	}
 
-	prop = rtb_style_query_prop_in_tree(self->parent,
-			"color", RTB_STYLE_PROP_COLOR, 1);
+	prop = rtb_style_query_in_tree(self->parent,
+			RTB_STYLE_KEY_COLOR, RTB_STYLE_PROP_COLOR, 1);
 	self->color = &prop->color;
 }
 
@@ -114,6 +113,11 @@ rtb_label_set_text(struct rtb_label *self, const rtb_utf8_t *text)
 {
 	struct rtb_size old_size;
 
+	/* value labels get set on every change of their value, which more
+	 * often than not formats to the same string. */
+	if (self->text && !strcmp(self->text, text))
+		return;
+
 	if (self->text)
 		free(self->text);
 
@@ -128,8 +132,7 @@ rtb_label_set_text(struct rtb_label *self, const rtb_utf8_t *text)
 	rtb_text_object_update(self->tobj, self->font, self->text);
 
 	if (self->tobj->w != old_size.w || self->tobj->h != old_size.h)
-		rtb_elem_trigger_reflow(self->parent, RTB_ELEMENT(self),
-				RTB_DIRECTION_ROOTWARD);
+		rtb_elem_request_reflow(RTB_ELEMENT(self));
 	else
 		rtb_elem_mark_dirty(RTB_ELEMENT(self));
 }
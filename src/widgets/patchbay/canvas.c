@@ -167,8 +167,8 @@ draw_bg(struct rtb_patchbay *self)
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
 
-	prop = rtb_style_query_prop(RTB_ELEMENT(self),
-			"background-image", RTB_STYLE_PROP_TEXTURE, 1);
+	prop = rtb_style_query(RTB_ELEMENT(self),
+			RTB_STYLE_KEY_BACKGROUND_IMAGE, RTB_STYLE_PROP_TEXTURE, 1);
 
 	glBindTexture(GL_TEXTURE_2D, self->bg_texture);
 	glUniform1i(shader.uniform.texture, 0);
@@ -177,8 +177,8 @@ draw_bg(struct rtb_patchbay *self)
 			roundf(self->texture_offset.x),
 			roundf(self->texture_offset.y));
 
-	prop = rtb_style_query_prop(RTB_ELEMENT(self),
-			"color", RTB_STYLE_PROP_COLOR, 1);
+	prop = rtb_style_query(RTB_ELEMENT(self),
+			RTB_STYLE_KEY_COLOR, RTB_STYLE_PROP_COLOR, 1);
 
 	glUniform4f(shader.uniform.front_color,
 			prop->color.r,
@@ -186,8 +186,8 @@ draw_bg(struct rtb_patchbay *self)
 			prop->color.b,
 			prop->color.a);
 
-	prop = rtb_style_query_prop(RTB_ELEMENT(self),
-			"background-color", RTB_STYLE_PROP_COLOR, 1);
+	prop = rtb_style_query(RTB_ELEMENT(self),
+			RTB_STYLE_KEY_BACKGROUND_COLOR, RTB_STYLE_PROP_COLOR, 1);
 
 	glUniform4f(shader.uniform.back_color,
 			prop->color.r,
@@ -202,6 +202,7 @@ draw_bg(struct rtb_patchbay *self)
 			self->window->local_storage.ibo.quad.solid);
 	glDrawElements(GL_TRIANGLE_STRIP, 4, GL_UNSIGNED_BYTE, 0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	ctx->window->frame_stats.draw_calls++;
 
 	glDisableVertexAttribArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -209,15 +210,17 @@ draw_bg(struct rtb_patchbay *self)
 }
 
 static void
-draw_line(GLfloat line[2][2])
+draw_line(struct rtb_render_context *ctx, GLfloat line[2][2])
 {
 	glBufferData(GL_ARRAY_BUFFER,
 			sizeof(GLfloat[2][2]), line, GL_STREAM_DRAW);
+	ctx->window->frame_stats.buffer_uploads++;
 
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
 
 	glDrawArrays(GL_LINES, 0, 2);
+	ctx->window->frame_stats.draw_calls++;
 }
 
 static void
@@ -232,7 +235,10 @@ draw_patches(struct rtb_patchbay *self)
 
 	rtb_render_reset(elem);
 	ctx = rtb_render_get_context(elem);
-	rtb_render_set_position(ctx, 0, 0);
+
+	/* the ports are in our content coordinates, but the patches are
+	 * drawn underneath the nodes, into the surface we're inside. */
+	rtb_render_set_position(ctx, -self->scroll.x, -self->scroll.y);
 
 	glEnable(GL_LINE_SMOOTH);
 	glLineWidth(3.5f);
@@ -259,7 +265,7 @@ draw_patches(struct rtb_patchbay *self)
 		else
 			rtb_render_set_color(ctx, CONNECTION_COLOR, .6f);
 
-		draw_line(line);
+		draw_line(ctx, line);
 	}
 
 	if (self->patch_in_progress.from) {
@@ -294,7 +300,7 @@ draw_patches(struct rtb_patchbay *self)
 		else
 			rtb_render_set_color(ctx, CONNECTION_COLOR, .4f);
 
-		draw_line(line);
+		draw_line(ctx, line);
 	}
 
 	glDisableVertexAttribArray(0);
@@ -333,21 +339,12 @@ reflow(struct rtb_element *elem,
 static void
 reposition(struct rtb_patchbay *self, struct rtb_point *by)
 {
-	struct rtb_element *iter;
-
-	TAILQ_FOREACH(iter, &self->children, child) {
-		iter->x += by->x;
-		iter->y += by->y;
-
-		rtb_elem_trigger_reflow(iter, RTB_ELEMENT(self),
-				RTB_DIRECTION_LEAFWARD);
-	}
-
+	/* the nodes stay where they are and the view moves over them, so
+	 * nothing gets laid out again and most of the surface is reused. */
 	self->texture_offset.x -= by->x;
 	self->texture_offset.y -= by->y;
 
-	rtb_surface_invalidate(RTB_SURFACE(self));
-	rtb_elem_mark_dirty(RTB_ELEMENT(self));
+	rtb_surface_scroll_by(RTB_SURFACE(self), -by->x, -by->y);
 }
 
 static int
@@ -411,8 +408,8 @@ restyle(struct rtb_element *elem)
 	old_style = self->style;
 	super.restyle(elem);
 
-	prop = rtb_style_query_prop(RTB_ELEMENT(self),
-			"background-image", RTB_STYLE_PROP_TEXTURE, 0);
+	prop = rtb_style_query(RTB_ELEMENT(self),
+			RTB_STYLE_KEY_BACKGROUND_IMAGE, RTB_STYLE_PROP_TEXTURE, 0);
 
 	if (prop)
 		load_tile(&prop->texture, self->bg_texture);
@@ -119,6 +119,14 @@ handle_connection(struct rtb_patchbay_port *a, struct rtb_patchbay_port *b)
 		dispatch_connect(from, to);
 }
 
+static void
+track_cursor(struct rtb_patchbay *patchbay, const struct rtb_mouse_event *e)
+{
+	patchbay->patch_in_progress.cursor = e->cursor;
+	rtb_surface_to_content(RTB_SURFACE(patchbay),
+			&patchbay->patch_in_progress.cursor);
+}
+
 static void
 start_patching(struct rtb_patchbay_port *self, const struct rtb_mouse_event *e)
 {
@@ -127,8 +135,7 @@ start_patching(struct rtb_patchbay_port *self, const struct rtb_mouse_event *e)
 	patchbay->patch_in_progress.from = self;
 	patchbay->patch_in_progress.to   = NULL;
 
-	patchbay->patch_in_progress.cursor.x = e->cursor.x;
-	patchbay->patch_in_progress.cursor.y = e->cursor.y;
+	track_cursor(patchbay, e);
 }
 
 static void
@@ -150,8 +157,7 @@ handle_drag(struct rtb_patchbay_port *self, const struct rtb_drag_event *e)
 		switch (e->type) {
 		case RTB_DRAG_START:
 		case RTB_DRAG_MOTION:
-			patchbay->patch_in_progress.cursor.x = e->cursor.x;
-			patchbay->patch_in_progress.cursor.y = e->cursor.y;
+			track_cursor(patchbay, RTB_UPCAST(e, rtb_mouse_event));
 			return 1;
 
 		case RTB_DRAG_ENTER:
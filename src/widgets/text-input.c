@@ -134,6 +134,7 @@ draw_cursor(struct rtb_text_input *self)
 	rtb_render_set_color(ctx, 1.f, 1.f, 1.f, 1.f);
 
 	glDrawArrays(GL_LINES, 0, 2);
+	ctx->window->frame_stats.draw_calls++;
 }
 
 static void
@@ -338,7 +339,7 @@ layout(struct rtb_element *elem)
 	ystart = elem->y + elem->outer_pad.y;
 
 	TAILQ_FOREACH(iter, &elem->children, child) {
-		iter->size_cb(iter, &avail, &child);
+		rtb_elem_measure(iter, &avail, &child);
 		position.y = ystart + valign(avail.h, child.h, iter->align);
 
 		rtb_elem_set_position_from_point(iter, &position);
@@ -0,0 +1,424 @@
+/**
+ * rutabaga: an OpenGL widget toolkit
+ * Copyright (c) 2013 William Light.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+#include <math.h>
+
+#include "rutabaga/rutabaga.h"
+#include "rutabaga/element.h"
+#include "rutabaga/surface.h"
+#include "rutabaga/window.h"
+#include "rutabaga/layout.h"
+#include "rutabaga/event.h"
+#include "rutabaga/mouse.h"
+
+#include "rutabaga/widgets/virtual-list.h"
+
+#include "rtb_private/util.h"
+#include "rtb_private/stdlib-allocator.h"
+
+#define SELF_FROM(elem) \
+	struct rtb_virtual_list *self = RTB_ELEMENT_AS(elem, rtb_virtual_list)
+
+#define DEFAULT_ITEM_HEIGHT	30.f
+#define DEFAULT_OVERSCAN	2
+
+/* how many rows one notch of the mouse wheel scrolls by. */
+#define WHEEL_ROWS	3
+
+static struct rtb_element_implementation super;
+
+/**
+ * geometry
+ */
+
+/* util.h's MIN() and MAX() go through floats. */
+static int
+imin(int a, int b)
+{
+	return (a < b) ? a : b;
+}
+
+static int
+imax(int a, int b)
+{
+	return (a > b) ? a : b;
+}
+
+static int
+row_count(struct rtb_virtual_list *self)
+{
+	return (self->count + self->columns - 1) / self->columns;
+}
+
+static float
+max_scroll_offset(struct rtb_virtual_list *self)
+{
+	float content_h = row_count(self) * self->item_height;
+	return fmax(content_h - self->inner_rect.h, 0.f);
+}
+
+/* enough slots to cover the viewport wherever it's scrolled to. this
+ * only changes when the list does size, so the item -> slot mapping
+ * stays put while scrolling. it goes by our size rather than
+ * `inner_rect`, which isn't brought up to date until we're reflowed. */
+static int
+slots_needed(struct rtb_virtual_list *self)
+{
+	float inner_h = self->h - (self->outer_pad.y * 2);
+	int rows;
+
+	if (!self->source || !self->count || self->item_height <= 0.f
+			|| inner_h <= 0.f)
+		return 0;
+
+	rows = ceilf(inner_h / self->item_height) + 1;
+	rows += self->overscan * 2;
+
+	return imin(rows * self->columns, self->count);
+}
+
+/**
+ * slot management
+ */
+
+static void
+resize_slots(struct rtb_virtual_list *self, int want)
+{
+	struct rtb_virtual_list_slot slot;
+	size_t i;
+
+	if (self->slots.size == (size_t) want)
+		return;
+
+	while (self->slots.size > (size_t) want) {
+		slot = *VECTOR_BACK(&self->slots);
+		VECTOR_POP_BACK(&self->slots);
+
+		rtb_elem_remove_child(RTB_ELEMENT(self), slot.elem);
+		VECTOR_PUSH_BACK(&self->pool, &slot.elem);
+	}
+
+	while (self->slots.size < (size_t) want) {
+		if (self->pool.size) {
+			slot.elem = *VECTOR_BACK(&self->pool);
+			VECTOR_POP_BACK(&self->pool);
+		} else
+			slot.elem = self->source->create(self, self->source_ctx);
+
+		rtb_elem_add_child(RTB_ELEMENT(self), slot.elem, RTB_ADD_TAIL);
+		VECTOR_PUSH_BACK(&self->slots, &slot);
+	}
+
+	/* the item -> slot mapping depends on how many slots there are. */
+	for (i = 0; i < self->slots.size; i++)
+		self->slots.data[i].index = -1;
+}
+
+static void
+drop_elements(struct rtb_virtual_list *self)
+{
+	struct rtb_element *elem;
+	size_t i;
+
+	resize_slots(self, 0);
+
+	for (i = 0; i < self->pool.size; i++) {
+		elem = self->pool.data[i];
+
+		if (self->source && self->source->destroy)
+			self->source->destroy(self, elem, self->source_ctx);
+	}
+
+	VECTOR_CLEAR(&self->pool);
+}
+
+/**
+ * element implementation
+ */
+
+static void
+layout(struct rtb_element *elem)
+{
+	struct rtb_virtual_list_slot *slot;
+	int i, first, last, row, col;
+	struct rtb_point position;
+	struct rtb_size cell;
+	SELF_FROM(elem);
+
+	if (!self->slots.size)
+		return;
+
+	self->scroll_offset = fmin(self->scroll_offset, max_scroll_offset(self));
+
+	first = floorf(self->scroll_offset / self->item_height);
+	first = imax(first - self->overscan, 0) * self->columns;
+	last  = imin(first + (int) self->slots.size, self->count);
+
+	cell.w = self->inner_rect.w / self->columns;
+	cell.h = self->item_height;
+
+	/* slots that don't have an item to show at the moment (which can
+	 * only happen near the end of the list) get parked just above us,
+	 * where they can't be seen or clicked on. */
+	for (i = last; i < first + (int) self->slots.size; i++) {
+		slot = &self->slots.data[i % self->slots.size];
+
+		position.x = self->inner_rect.x;
+		position.y = self->y - cell.h;
+
+		rtb_elem_set_position_from_point(slot->elem, &position);
+		rtb_elem_set_size(slot->elem, &cell);
+		slot->index = -1;
+	}
+
+	for (i = first; i < last; i++) {
+		slot = &self->slots.data[i % self->slots.size];
+
+		if (slot->index != i) {
+			self->source->bind(self, slot->elem, i, self->source_ctx);
+			slot->index = i;
+		}
+
+		row = i / self->columns;
+		col = i % self->columns;
+
+		position.x = self->inner_rect.x + (col * cell.w);
+		position.y = self->inner_rect.y + (row * cell.h)
+			- self->scroll_offset;
+
+		/* the overscan rows end up outside of our rect, which makes
+		 * them RTB_FULLY_OBSCURED once they're reflowed. they're bound
+		 * and laid out, ready to scroll in, but won't be drawn. */
+		rtb_elem_set_position_from_point(slot->elem, &position);
+		rtb_elem_set_size(slot->elem, &cell);
+	}
+}
+
+/* the slot pool is sized here and in relayout(), ahead of layout(),
+ * so that layout() only ever binds and positions slots. */
+static int
+reflow(struct rtb_element *elem,
+		struct rtb_element *instigator, rtb_ev_direction_t direction)
+{
+	struct rtb_element *marked, *iter;
+	SELF_FROM(elem);
+
+	/* adding and removing slots marks everything up to the window as
+	 * needing layout. we're in the middle of being laid out, though,
+	 * and lay the slots out straight after, so those marks would only
+	 * cost another pass next frame. ancestors that were already marked
+	 * (and everything above them) keep theirs. */
+	marked = elem->parent;
+	while (marked && !marked->need_layout)
+		marked = marked->parent;
+
+	resize_slots(self, slots_needed(self));
+
+	for (iter = elem->parent; iter != marked; iter = iter->parent)
+		iter->need_layout = 0;
+
+	return super.reflow(elem, instigator, direction);
+}
+
+static int
+on_event(struct rtb_element *elem, const struct rtb_event *e)
+{
+	const struct rtb_mouse_event *mouse_event;
+	SELF_FROM(elem);
+
+	switch (e->type) {
+	case RTB_MOUSE_WHEEL:
+		mouse_event = RTB_EVENT_AS(e, rtb_mouse_event);
+
+		rtb_virtual_list_scroll_to(self, self->scroll_offset
+				- (mouse_event->wheel.delta
+					* self->item_height * WHEEL_ROWS));
+		return 1;
+
+	default:
+		return super.on_event(elem, e);
+	}
+}
+
+static void
+attached(struct rtb_element *elem,
+		struct rtb_element *parent, struct rtb_window *window)
+{
+	SELF_FROM(elem);
+
+	super.attached(elem, parent, window);
+	self->type = rtb_type_ref(window, self->type,
+			"net.illest.rutabaga.widgets.virtual-list");
+}
+
+/**
+ * public API
+ */
+
+static void
+relayout(struct rtb_virtual_list *self)
+{
+	resize_slots(self, slots_needed(self));
+	rtb_elem_request_layout(RTB_ELEMENT(self));
+
+	/* pretty much everything on the surface is going to move. */
+	if (self->state != RTB_STATE_UNATTACHED)
+		rtb_surface_invalidate(RTB_SURFACE(self));
+}
+
+void
+rtb_virtual_list_set_source(struct rtb_virtual_list *self,
+		const struct rtb_virtual_list_source *source, void *ctx)
+{
+	drop_elements(self);
+
+	self->source = source;
+	self->source_ctx = ctx;
+
+	relayout(self);
+}
+
+void
+rtb_virtual_list_set_count(struct rtb_virtual_list *self, int count)
+{
+	self->count = imax(count, 0);
+	rtb_virtual_list_reload(self);
+}
+
+void
+rtb_virtual_list_set_item_height(struct rtb_virtual_list *self, float h)
+{
+	self->item_height = h;
+	relayout(self);
+}
+
+void
+rtb_virtual_list_set_columns(struct rtb_virtual_list *self, int columns)
+{
+	self->columns = imax(columns, 1);
+	rtb_virtual_list_reload(self);
+}
+
+void
+rtb_virtual_list_scroll_to(struct rtb_virtual_list *self, float offset)
+{
+	offset = fmax(offset, 0.f);
+
+	/* layout() clamps the other end, since it depends on our size. */
+	if (self->state != RTB_STATE_UNATTACHED)
+		offset = fmin(offset, max_scroll_offset(self));
+
+	if (offset == self->scroll_offset)
+		return;
+
+	self->scroll_offset = offset;
+	relayout(self);
+}
+
+void
+rtb_virtual_list_reload(struct rtb_virtual_list *self)
+{
+	size_t i;
+
+	for (i = 0; i < self->slots.size; i++)
+		self->slots.data[i].index = -1;
+
+	relayout(self);
+}
+
+void
+rtb_virtual_list_item_changed(struct rtb_virtual_list *self, int index)
+{
+	struct rtb_virtual_list_slot *slot;
+
+	if (!self->slots.size || index < 0)
+		return;
+
+	slot = &self->slots.data[index % self->slots.size];
+
+	if (slot->index == index)
+		self->source->bind(self, slot->elem, index, self->source_ctx);
+}
+
+int
+rtb_virtual_list_init(struct rtb_virtual_list *self)
+{
+	if (RTB_SUBCLASS(RTB_SURFACE(self), rtb_surface_init, &super))
+		return -1;
+
+	self->on_event  = on_event;
+	self->attached  = attached;
+	self->reflow    = reflow;
+	self->layout_cb = layout;
+	self->size_cb   = rtb_size_fill;
+
+	self->source = NULL;
+	self->source_ctx = NULL;
+
+	self->count = 0;
+	self->columns = 1;
+	self->item_height = DEFAULT_ITEM_HEIGHT;
+	self->overscan = DEFAULT_OVERSCAN;
+	self->scroll_offset = 0.f;
+
+	VECTOR_INIT(&self->slots, &stdlib_allocator, 16);
+	VECTOR_INIT(&self->pool, &stdlib_allocator, 4);
+
+	return 0;
+}
+
+void
+rtb_virtual_list_fini(struct rtb_virtual_list *self)
+{
+	drop_elements(self);
+
+	VECTOR_FREE(&self->pool);
+	VECTOR_FREE(&self->slots);
+
+	rtb_surface_fini(RTB_SURFACE(self));
+}
+
+struct rtb_virtual_list *
+rtb_virtual_list_new()
+{
+	struct rtb_virtual_list *self = calloc(1, sizeof(*self));
+
+	if (rtb_virtual_list_init(self)) {
+		free(self);
+		return NULL;
+	}
+
+	return self;
+}
+
+void
+rtb_virtual_list_free(struct rtb_virtual_list *self)
+{
+	rtb_virtual_list_fini(self);
+	free(self);
+}
@@ -27,6 +27,7 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "rutabaga/rutabaga.h"
 #include "rutabaga/event.h"
@@ -39,6 +40,7 @@
 #include "rutabaga/surface.h"
 #include "rutabaga/style.h"
 #include "rutabaga/mat4.h"
+#include "rutabaga/text-object.h"
 
 #include "rtb_private/util.h"
 #include "rtb_private/window_impl.h"
@@ -46,6 +48,7 @@
 #include "shaders/default.glsl.h"
 #include "shaders/surface.glsl.h"
 #include "shaders/stylequad.glsl.h"
+#include "shaders/batch.glsl.h"
 
 #define ERR(...) fprintf(stderr, "rutabaga: " __VA_ARGS__)
 #define SELF_FROM(elem) \
@@ -171,6 +174,35 @@ ibos_fini(struct rtb_window *self)
 	ibo_free(self->local_storage.ibo.quad.solid);
 }
 
+/**
+ * vertex buffer objects
+ */
+
+static int
+vbos_init(struct rtb_window *self)
+{
+	GLuint *vbo = &self->local_storage.vbo.stylequad;
+
+	glGenBuffers(1, vbo);
+	if (!*vbo)
+		return -1;
+
+	/* stylequads drawn outside of a batch stream their vertices and
+	 * texture coordinates through this one. */
+	glBindBuffer(GL_ARRAY_BUFFER, *vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat[2][16][2]),
+			NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	return 0;
+}
+
+static void
+vbos_fini(struct rtb_window *self)
+{
+	glDeleteBuffers(1, &self->local_storage.vbo.stylequad);
+}
+
 /**
  * shaders
  */
@@ -190,8 +222,23 @@ shaders_init(struct rtb_window *self)
 				STYLEQUAD_VERT_SHADER, NULL, STYLEQUAD_FRAG_SHADER))
 		goto err_stylequad;
 
+	if (!rtb_shader_create(RTB_SHADER(&self->local_storage.shader.batch),
+				BATCH_VERT_SHADER, NULL, BATCH_FRAG_SHADER))
+		goto err_batch;
+
+#define CACHE_ATTRIBUTE(ATTRIBUTE)                                    \
+	self->local_storage.shader.batch.ATTRIBUTE = glGetAttribLocation( \
+			self->local_storage.shader.batch.program, #ATTRIBUTE)
+
+	CACHE_ATTRIBUTE(vertex_color);
+	CACHE_ATTRIBUTE(tex_layer);
+
+#undef CACHE_ATTRIBUTE
+
 	return 0;
 
+err_batch:
+	rtb_shader_free(&self->local_storage.shader.stylequad);
 err_stylequad:
 	rtb_shader_free(&self->local_storage.shader.surface);
 err_surface:
@@ -203,6 +250,7 @@ err_dfault:
 static void
 shaders_fini(struct rtb_window *self)
 {
+	rtb_shader_free(RTB_SHADER(&self->local_storage.shader.batch));
 	rtb_shader_free(&self->local_storage.shader.stylequad);
 	rtb_shader_free(&self->local_storage.shader.surface);
 	rtb_shader_free(&self->local_storage.shader.dfault);
@@ -258,6 +306,209 @@ mark_dirty(struct rtb_element *elem)
 	self->dirty = 1;
 }
 
+/**
+ * damage
+ */
+
+/* works out which parts of the back buffer need repainting this frame.
+ * with a buffer age of N, the back buffer holds what we presented N
+ * frames ago, so it's missing this frame's damage plus that of the N - 1
+ * frames in between. an age of 0 means its contents are undefined. */
+static void
+repaint_region(struct rtb_window *self, const struct rtb_damage *damage,
+		struct rtb_damage *region)
+{
+	struct rtb_rect everything = {
+		.x  = 0.f,     .y  = 0.f,
+		.x2 = self->w, .y2 = self->h
+	};
+	int i, j, age = self->buffer_age;
+
+	rtb_damage_clear(region);
+
+	if (age < 1 || age > RTB_WINDOW_DAMAGE_HISTORY + 1) {
+		rtb_damage_add(region, &everything);
+		return;
+	}
+
+	*region = *damage;
+
+	for (i = 0; i < age - 1; i++)
+		for (j = 0; j < self->damage_history[i].count; j++)
+			rtb_damage_add(region, &self->damage_history[i].rects[j]);
+}
+
+static void
+push_damage_history(struct rtb_window *self, const struct rtb_damage *damage)
+{
+	memmove(&self->damage_history[1], &self->damage_history[0],
+			sizeof(self->damage_history) - sizeof(*damage));
+
+	self->damage_history[0] = *damage;
+}
+
+/**
+ * frame stats
+ */
+
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+
+#define STATS_OVERLAY_PADDING 4
+
+static int
+has_timer_query(void)
+{
+	GLint i, extensions;
+
+	if (ogl_IsVersionGEQ(3, 3))
+		return 1;
+
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+
+	for (i = 0; i < extensions; i++)
+		if (!strcmp((const char *) glGetStringi(GL_EXTENSIONS, i),
+					"GL_ARB_timer_query"))
+			return 1;
+
+	return 0;
+}
+
+static void
+gpu_timer_init(struct rtb_window *self)
+{
+	self->gpu_timer.frame = 0;
+	self->gpu_timer.supported = has_timer_query();
+
+	if (self->gpu_timer.supported)
+		glGenQueries(RTB_FRAME_STATS_QUERIES, self->gpu_timer.queries);
+}
+
+static void
+gpu_timer_fini(struct rtb_window *self)
+{
+	if (self->gpu_timer.supported)
+		glDeleteQueries(RTB_FRAME_STATS_QUERIES, self->gpu_timer.queries);
+}
+
+static void
+gpu_timer_begin(struct rtb_window *self)
+{
+	GLuint query, available, elapsed;
+
+	if (!self->gpu_timer.supported)
+		return;
+
+	query = self->gpu_timer.queries[
+		self->gpu_timer.frame % RTB_FRAME_STATS_QUERIES];
+
+	/* the last frame to use this query was RTB_FRAME_STATS_QUERIES
+	 * frames ago, which is usually long enough for it to be done. if it
+	 * isn't, we drop it rather than wait. */
+	if (self->gpu_timer.frame >= RTB_FRAME_STATS_QUERIES) {
+		glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+
+		if (available) {
+			glGetQueryObjectuiv(query, GL_QUERY_RESULT, &elapsed);
+			self->frame_stats.gpu_ns = elapsed;
+		}
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED, query);
+}
+
+static void
+gpu_timer_end(struct rtb_window *self)
+{
+	if (!self->gpu_timer.supported)
+		return;
+
+	glEndQuery(GL_TIME_ELAPSED);
+	self->gpu_timer.frame++;
+}
+
+static void
+finish_frame_stats(struct rtb_window *self)
+{
+	self->last_frame_stats = self->frame_stats;
+	memset(&self->frame_stats, 0, sizeof(self->frame_stats));
+}
+
+/* lays out the overlay text and adds the overlay's area (both where it
+ * was last frame and where it is now) to this frame's damage, since it's
+ * drawn straight into the window's framebuffer on top of the surface. */
+static void
+stats_overlay_update(struct rtb_window *self, struct rtb_damage *damage)
+{
+	const struct rtb_frame_stats *stats = &self->last_frame_stats;
+	const struct rtb_style_property_definition *prop;
+	struct rtb_text_object *text;
+	char buf[160];
+
+	prop = rtb_style_query(RTB_ELEMENT(self),
+			RTB_STYLE_KEY_FONT, RTB_STYLE_PROP_FONT, 0);
+	if (!prop)
+		return;
+
+	if (!self->stats_overlay.text)
+		self->stats_overlay.text = rtb_text_object_new(&self->font_manager);
+
+	if (!(text = self->stats_overlay.text))
+		return;
+
+	snprintf(buf, sizeof(buf),
+			"cpu %.2f ms (events %.2f, layout %.2f, draw %.2f)  "
+			"gpu %.2f ms  %u draws  %u uploads  %u elements  %u queued",
+			(stats->event_ns + stats->layout_ns + stats->draw_ns) / 1e+06,
+			stats->event_ns / 1e+06,
+			stats->layout_ns / 1e+06,
+			stats->draw_ns / 1e+06,
+			stats->gpu_ns / 1e+06,
+			stats->draw_calls,
+			stats->buffer_uploads,
+			stats->elements_drawn,
+			stats->render_queue_length);
+
+	/* XXX: const issues */
+	rtb_text_object_update(text,
+			(struct rtb_font *) &prop->font.font_internal, buf);
+
+	if (self->stats_overlay.rect.x2 > 0.f)
+		rtb_damage_add(damage, &self->stats_overlay.rect);
+
+	self->stats_overlay.rect = (struct rtb_rect) {
+		.x  = 0.f,
+		.y  = 0.f,
+		.x2 = text->w + (STATS_OVERLAY_PADDING * 2),
+		.y2 = text->h + (STATS_OVERLAY_PADDING * 2)
+	};
+
+	rtb_damage_add(damage, &self->stats_overlay.rect);
+}
+
+static void
+stats_overlay_draw(struct rtb_window *self)
+{
+	const struct rtb_style_property_definition *prop;
+
+	if (!self->stats_overlay.text)
+		return;
+
+	prop = rtb_style_query(RTB_ELEMENT(self),
+			RTB_STYLE_KEY_COLOR, RTB_STYLE_PROP_COLOR, 1);
+
+	/* the text batch scissors to the text's own bounds when it's
+	 * flushed, which lie inside the overlay's rect. */
+	rtb_text_object_render(self->stats_overlay.text,
+			&RTB_SURFACE(self)->render_ctx,
+			STATS_OVERLAY_PADDING, STATS_OVERLAY_PADDING, &prop->color);
+
+	/* the window's children have already been flushed, so nothing else
+	 * is coming along to draw the overlay's text. */
+	rtb_render_flush(&RTB_SURFACE(self)->render_ctx);
+}
+
 /**
  * public API
  */
@@ -285,7 +536,11 @@ int
 rtb_window_draw(struct rtb_window *self, int force_redraw)
 {
 	const struct rtb_style_property_definition *prop;
+	struct rtb_damage damage, region;
 	struct rtb_window_event ev;
+	struct rtb_rect *rect;
+	uint64_t start;
+	int i;
 
 	if (self->state == RTB_STATE_UNATTACHED
 			|| self->visibility == RTB_FULLY_OBSCURED)
@@ -294,33 +549,81 @@ rtb_window_draw(struct rtb_window *self, int force_redraw)
 	ev.type = RTB_FRAME_START;
 	ev.source = RTB_EVENT_GENUINE;
 	ev.window = self;
+	ev.stats = &self->last_frame_stats;
 	rtb_dispatch_raw(RTB_ELEMENT(self), RTB_EVENT(&ev));
 
+	/* uploading glyphs needs the GL, so the prewarm thread leaves it to
+	 * us. nothing has to be redrawn for it: any glyph already on screen
+	 * was rasterised on demand. */
+	rtb_font_manager_add_prewarmed_glyphs(&self->font_manager);
+
+	/* the layout phase: everything that asked for a reflow since the
+	 * last frame gets one now, which may well dirty us. */
+	rtb_elem_flush_layout(RTB_ELEMENT(self));
+
 	if (!self->dirty || force_redraw)
 		return 0;
 
+	start = uv_hrtime();
+	gpu_timer_begin(self);
+
 	glViewport(0, 0, self->w, self->h);
 
-	prop = rtb_style_query_prop(RTB_ELEMENT(self),
-			"background-color", RTB_STYLE_PROP_COLOR, 1);
+	prop = rtb_style_query(RTB_ELEMENT(self),
+			RTB_STYLE_KEY_BACKGROUND_COLOR, RTB_STYLE_PROP_COLOR, 1);
 
 	glEnable(GL_DITHER);
 	glEnable(GL_BLEND);
 	glEnable(GL_SCISSOR_TEST);
 
+	/* drawing the children consumes the surface's damage, so grab it
+	 * first. */
+	damage = RTB_SURFACE(self)->damage;
+
+	if (self->stats_overlay.visible)
+		stats_overlay_update(self, &damage);
+	else if (self->stats_overlay.rect.x2 > 0.f) {
+		/* it's just been hidden, so blit back over where it was. */
+		rtb_damage_add(&damage, &self->stats_overlay.rect);
+		self->stats_overlay.rect.x2 = 0.f;
+	}
+
+	repaint_region(self, &damage, &region);
+
+	rtb_render_push(RTB_ELEMENT(self));
+	rtb_surface_draw_children(RTB_SURFACE(self));
+
+	/* the surface might've turned the scissor test off on us. */
+	glEnable(GL_SCISSOR_TEST);
+
 	glClearColor(
 			prop->color.r,
 			prop->color.g,
 			prop->color.b,
 			prop->color.a);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	rtb_render_push(RTB_ELEMENT(self));
-	self->draw(RTB_ELEMENT(self));
+	for (i = 0; i < region.count; i++) {
+		rect = &region.rects[i];
+
+		glScissor(rect->x, self->h - rect->y2,
+				rect->x2 - rect->x, rect->y2 - rect->y);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		rtb_surface_blit_rect(RTB_SURFACE(self), rect);
+	}
+
+	if (self->stats_overlay.visible)
+		stats_overlay_draw(self);
+
 	rtb_render_pop(RTB_ELEMENT(self));
 
+	push_damage_history(self, &damage);
 	self->dirty = 0;
 
+	gpu_timer_end(self);
+	self->frame_stats.draw_ns += uv_hrtime() - start;
+	finish_frame_stats(self);
+
 	ev.type = RTB_FRAME_END;
 	rtb_dispatch_raw(RTB_ELEMENT(self), RTB_EVENT(&ev));
 
@@ -342,6 +645,46 @@ rtb_window_reinit(struct rtb_window *self)
 	rtb_elem_trigger_reflow(elem, elem, RTB_DIRECTION_LEAFWARD);
 }
 
+const struct rtb_frame_stats *
+rtb_window_get_frame_stats(struct rtb_window *self)
+{
+	return &self->last_frame_stats;
+}
+
+void
+rtb_window_show_frame_stats(struct rtb_window *self, int show)
+{
+	self->stats_overlay.visible = !!show;
+	rtb_elem_mark_dirty(RTB_ELEMENT(self));
+}
+
+int
+rtb_window_read_pixels(struct rtb_window *self, uint8_t *dest)
+{
+	int w, h, row_size, y;
+	uint8_t *row;
+
+	w = self->w;
+	h = self->h;
+	row_size = w * 4;
+
+	if (!(row = malloc(row_size)))
+		return -1;
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, dest);
+
+	/* GL hands us the bottom row first. */
+	for (y = 0; y < h / 2; y++) {
+		memcpy(row, dest + y * row_size, row_size);
+		memcpy(dest + y * row_size, dest + (h - y - 1) * row_size, row_size);
+		memcpy(dest + (h - y - 1) * row_size, row, row_size);
+	}
+
+	free(row);
+	return 0;
+}
+
 static int
 init_gl(void)
 {
@@ -391,6 +734,9 @@ rtb_window_open_under(struct rutabaga *r, intptr_t parent,
 	if (ibos_init(self))
 		goto err_ibos;
 
+	if (vbos_init(self))
+		goto err_vbos;
+
 	if (rtb_font_manager_init(&self->font_manager,
 				self->dpi.x, self->dpi.y))
 		goto err_font;
@@ -412,9 +758,13 @@ rtb_window_open_under(struct rutabaga *r, intptr_t parent,
 
 	self->mouse.current_cursor = RTB_MOUSE_CURSOR_DEFAULT;
 
+	gpu_timer_init(self);
+
 	return self;
 
 err_font:
+	vbos_fini(self);
+err_vbos:
 	ibos_fini(self);
 err_ibos:
 	shaders_fini(self);
@@ -440,8 +790,15 @@ rtb_window_close(struct rtb_window *self)
 	glBindVertexArray(0);
 	glDeleteVertexArrays(1, &self->vao);
 
+	if (self->stats_overlay.text)
+		rtb_text_object_free(self->stats_overlay.text);
+
+	gpu_timer_fini(self);
+
 	rtb_font_manager_fini(&self->font_manager);
+	rtb_style_atlas_fini(&self->style_atlas);
 
+	vbos_fini(self);
 	ibos_fini(self);
 	shaders_fini(self);
 
@@ -0,0 +1,177 @@
+/* ============================================================================
+ * Freetype GL - A C OpenGL Freetype engine
+ * Platform:    Any
+ * WWW:         http://code.google.com/p/freetype-gl/
+ * ----------------------------------------------------------------------------
+ * Copyright 2011,2012 Nicolas P. Rougier. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NICOLAS P. ROUGIER ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL NICOLAS P. ROUGIER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of Nicolas P. Rougier.
+ * ============================================================================
+ */
+#include <stdlib.h>
+#include <math.h>
+#include "distance-field.h"
+
+// Far enough to never be the nearest, without inf - inf turning into NaN.
+#define INFINITE_DISTANCE 1e20f
+
+// ------------------------------------------------------------------ edt ---
+// One dimensional squared distance transform of `length` samples starting
+// at `grid[offset]`, `stride` apart: the lower envelope of the parabolas
+// rooted at each sample.
+static void
+edt( float * grid, size_t offset, size_t stride, size_t length,
+     float * f, float * z, size_t * v )
+{
+    size_t q, r;
+    float s;
+    int k = 0;
+
+    v[0] = 0;
+    z[0] = -INFINITE_DISTANCE;
+    z[1] = INFINITE_DISTANCE;
+    f[0] = grid[offset];
+
+    for( q = 1; q < length; ++q )
+    {
+        f[q] = grid[offset + q * stride];
+
+        do
+        {
+            r = v[k];
+            s = (f[q] - f[r] + (float) q * q - (float) r * r)
+                / (2.f * q - 2.f * r);
+        } while( s <= z[k] && --k >= 0 );
+
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = INFINITE_DISTANCE;
+    }
+
+    for( q = 0, k = 0; q < length; ++q )
+    {
+        while( z[k + 1] < q )
+            ++k;
+
+        r = v[k];
+        grid[offset + q * stride] = f[r] + ((float) q - r) * ((float) q - r);
+    }
+}
+
+// ---------------------------------------------------------------- edt_2d ---
+static void
+edt_2d( float * grid, size_t width, size_t height,
+        float * f, float * z, size_t * v )
+{
+    size_t x, y;
+
+    for( x = 0; x < width; ++x )
+        edt( grid, x, width, height, f, z, v );
+
+    for( y = 0; y < height; ++y )
+        edt( grid, y * width, 1, width, f, z, v );
+}
+
+// --------------------------------------------------- make_distance_field ---
+unsigned char *
+make_distance_field( const unsigned char * image,
+                     size_t width, size_t height, size_t pitch,
+                     size_t spread )
+{
+    size_t w = width  + 2 * spread;
+    size_t h = height + 2 * spread;
+    size_t x, y, i, longest = w > h ? w : h;
+    float *outer, *inner, *f, *z;
+    unsigned char *field;
+    size_t *v;
+
+    field = malloc( w * h );
+    outer = malloc( w * h * sizeof( float ) );
+    inner = malloc( w * h * sizeof( float ) );
+    f = malloc( longest * sizeof( float ) );
+    z = malloc( (longest + 1) * sizeof( float ) );
+    v = malloc( longest * sizeof( size_t ) );
+
+    if( !field || !outer || !inner || !f || !z || !v )
+    {
+        free( field );
+        field = NULL;
+        goto out;
+    }
+
+    // Pixels wholly in or out of the glyph are at distance 0 from
+    // themselves. Partly covered ones have the edge running through them,
+    // about (coverage - 0.5) of a pixel from their centre.
+    for( i = 0; i < w * h; ++i )
+    {
+        outer[i] = INFINITE_DISTANCE;
+        inner[i] = 0.f;
+    }
+
+    for( y = 0; y < height; ++y )
+    {
+        for( x = 0; x < width; ++x )
+        {
+            float a = image[y * pitch + x] / 255.f;
+            float d;
+
+            i = (y + spread) * w + x + spread;
+
+            if( a >= 1.f )
+            {
+                outer[i] = 0.f;
+                inner[i] = INFINITE_DISTANCE;
+            }
+            else if( a > 0.f )
+            {
+                d = 0.5f - a;
+                outer[i] = d > 0.f ? d * d : 0.f;
+                inner[i] = d < 0.f ? d * d : 0.f;
+            }
+        }
+    }
+
+    edt_2d( outer, w, h, f, z, v );
+    edt_2d( inner, w, h, f, z, v );
+
+    for( i = 0; i < w * h; ++i )
+    {
+        float d = sqrtf( outer[i] ) - sqrtf( inner[i] );
+        float value = 0.5f - d / (2.f * spread);
+
+        value = value < 0.f ? 0.f : value > 1.f ? 1.f : value;
+        field[i] = (unsigned char) roundf( value * 255.f );
+    }
+
+out:
+    free( v );
+    free( z );
+    free( f );
+    free( inner );
+    free( outer );
+    return field;
+}
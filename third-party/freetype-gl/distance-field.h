@@ -0,0 +1,87 @@
+/* ============================================================================
+ * Freetype GL - A C OpenGL Freetype engine
+ * Platform:    Any
+ * WWW:         http://code.google.com/p/freetype-gl/
+ * ----------------------------------------------------------------------------
+ * Copyright 2011,2012 Nicolas P. Rougier. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NICOLAS P. ROUGIER ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL NICOLAS P. ROUGIER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of Nicolas P. Rougier.
+ * ============================================================================
+ */
+#ifndef __DISTANCE_FIELD_H__
+#define __DISTANCE_FIELD_H__
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file   distance-field.h
+ *
+ * @defgroup distance-field Distance field
+ *
+ * Turns a coverage bitmap, as rendered by FreeType, into a signed distance
+ * field: each texel holds the distance to the nearest outline, with 0.5
+ * (127.5) on the outline itself, rising towards 1 inside the glyph and
+ * falling towards 0 outside of it. Sampled with linear filtering, the field
+ * reproduces the outline at any scale.
+ *
+ * Distances are exact euclidean distances (Felzenszwalb & Huttenlocher,
+ * "Distance Transforms of Sampled Functions", 2012), seeded from the
+ * coverage of the antialiased edge so that the outline keeps its subpixel
+ * position.
+ *
+ * @{
+ */
+
+/**
+ * Computes the signed distance field of a coverage bitmap.
+ *
+ *  @param image   8-bit coverage, one byte per pixel
+ *  @param width   width of the bitmap in pixels
+ *  @param height  height of the bitmap in pixels
+ *  @param pitch   bytes per row of the bitmap
+ *  @param spread  how far from the outline, in pixels, the field reaches.
+ *                 the field is this much bigger than the bitmap on every
+ *                 side.
+ *
+ *  @return        a newly allocated (width + 2 * spread) by
+ *                 (height + 2 * spread) field, or NULL if out of memory
+ */
+  unsigned char *
+  make_distance_field( const unsigned char * image,
+                       size_t width, size_t height, size_t pitch,
+                       size_t spread );
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DISTANCE_FIELD_H__ */
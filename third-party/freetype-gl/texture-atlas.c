@@ -68,6 +68,15 @@ texture_atlas_new( const size_t width,
     self->height = height;
     self->depth = depth;
     self->id = 0;
+    self->budget = width*height*depth;
+    self->generation = 0;
+    self->clock = 0;
+    self->dirty.x0 = self->dirty.y0 = 0;
+    self->dirty.x1 = width;
+    self->dirty.y1 = height;
+    self->texture.width = 0;
+    self->texture.height = 0;
+    self->fonts = vector_new( sizeof(void *) );
 
     self->dpi.x = x_dpi;
     self->dpi.y = y_dpi;
@@ -93,6 +102,7 @@ texture_atlas_delete( texture_atlas_t *self )
 {
     assert( self );
     vector_delete( self->nodes );
+    vector_delete( self->fonts );
     if( self->data )
     {
         free( self->data );
@@ -134,6 +144,29 @@ texture_atlas_set_region( texture_atlas_t * self,
         memcpy( self->data+((y+i)*self->width + x ) * charsize * depth,
                 data + (i*stride) * charsize, width * charsize * depth  );
     }
+
+    if( !width || !height )
+    {
+        return;
+    }
+
+    if( self->dirty.x1 <= self->dirty.x0 )
+    {
+        self->dirty.x0 = x;
+        self->dirty.y0 = y;
+        self->dirty.x1 = x + width;
+        self->dirty.y1 = y + height;
+        return;
+    }
+
+    if( x < self->dirty.x0 )
+        self->dirty.x0 = x;
+    if( y < self->dirty.y0 )
+        self->dirty.y0 = y;
+    if( x + width > self->dirty.x1 )
+        self->dirty.x1 = x + width;
+    if( y + height > self->dirty.y1 )
+        self->dirty.y1 = y + height;
 }
 
 
@@ -307,46 +340,162 @@ texture_atlas_clear( texture_atlas_t * self )
 
     vector_push_back( self->nodes, &node );
     memset( self->data, 0, self->width*self->height*self->depth );
+
+    self->dirty.x0 = self->dirty.y0 = 0;
+    self->dirty.x1 = self->width;
+    self->dirty.y1 = self->height;
+    self->generation++;
 }
 
 
-// --------------------------------------------------- texture_atlas_upload ---
-void
-texture_atlas_upload( texture_atlas_t * self )
+// ----------------------------------------------------- texture_atlas_grow ---
+int
+texture_atlas_grow( texture_atlas_t * self )
 {
+    size_t width, height, depth, y;
+    unsigned char *data;
+    GLint max_size;
+    ivec3 node;
+
     assert( self );
     assert( self->data );
 
-    if( !self->id )
+    width  = self->width;
+    height = self->height;
+    depth  = self->depth;
+
+    // Keep the atlas square-ish: widen it first, then make it taller.
+    if( width <= height )
+        width *= 2;
+    else
+        height *= 2;
+
+    glGetIntegerv( GL_MAX_TEXTURE_SIZE, &max_size );
+    if( width*height*depth > self->budget ||
+        width > (size_t) max_size || height > (size_t) max_size )
     {
-        glGenTextures( 1, &self->id );
+        return -1;
     }
 
-    glBindTexture( GL_TEXTURE_2D, self->id );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+    data = (unsigned char *) calloc( width*height*depth, sizeof(unsigned char) );
+    if( data == NULL )
+    {
+        return -1;
+    }
+
+    for( y=0; y<self->height; ++y )
+    {
+        memcpy( data + y*width*depth,
+                self->data + y*self->width*depth, self->width*depth );
+    }
+
+    free( self->data );
+    self->data = data;
+
+    // The old right hand border is free to use now, along with everything
+    // to the right of it. Growing taller needs nothing, since the skyline
+    // is only bounded by the height when fitting.
+    if( width > self->width )
+    {
+        node.x = self->width - 1;
+        node.y = 1;
+        node.z = width - self->width;
+        vector_push_back( self->nodes, &node );
+        texture_atlas_merge( self );
+    }
+
+    self->width  = width;
+    self->height = height;
+
+    self->dirty.x0 = self->dirty.y0 = 0;
+    self->dirty.x1 = width;
+    self->dirty.y1 = height;
+    self->generation++;
+    return 0;
+}
+
+
+// --------------------------------------------------- texture_atlas_upload ---
+static void
+texture_atlas_formats( const texture_atlas_t * self,
+                       GLint * internal_format,
+                       GLenum * format,
+                       GLenum * type )
+{
+    *type = GL_UNSIGNED_BYTE;
+
     if( self->depth == 4 )
     {
+        *internal_format = GL_RGBA;
 #ifdef GL_UNSIGNED_INT_8_8_8_8_REV
-        glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, self->width, self->height,
-                      0, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, self->data );
+        *format = GL_BGRA;
+        *type = GL_UNSIGNED_INT_8_8_8_8_REV;
 #else
-        glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, self->width, self->height,
-                      0, GL_RGBA, GL_UNSIGNED_BYTE, self->data );
+        *format = GL_RGBA;
 #endif
     }
     else if( self->depth == 3 )
     {
-        glTexImage2D( GL_TEXTURE_2D, 0, GL_RGB, self->width, self->height,
-                      0, GL_RGB, GL_UNSIGNED_BYTE, self->data );
+        *internal_format = GL_RGB;
+        *format = GL_RGB;
     }
     else
     {
-        glTexImage2D( GL_TEXTURE_2D, 0, GL_RED, self->width, self->height,
-                      0, GL_RED, GL_UNSIGNED_BYTE, self->data );
+        *internal_format = GL_RED;
+        *format = GL_RED;
     }
 }
 
+void
+texture_atlas_upload( texture_atlas_t * self )
+{
+    GLint internal_format;
+    GLenum format, type;
+    size_t x, y;
+
+    assert( self );
+    assert( self->data );
+
+    if( !self->id )
+    {
+        glGenTextures( 1, &self->id );
+    }
+
+    texture_atlas_formats( self, &internal_format, &format, &type );
+    glBindTexture( GL_TEXTURE_2D, self->id );
+
+    if( self->texture.width != self->width ||
+        self->texture.height != self->height )
+    {
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+        glTexImage2D( GL_TEXTURE_2D, 0, internal_format,
+                      self->width, self->height, 0, format, type, self->data );
+
+        self->texture.width = self->width;
+        self->texture.height = self->height;
+    }
+    else if( self->dirty.x1 > self->dirty.x0 )
+    {
+        // Only send the rows and columns that changed, reading them
+        // straight out of the atlas data.
+        x = self->dirty.x0;
+        y = self->dirty.y0;
+
+        glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+        glPixelStorei( GL_UNPACK_ROW_LENGTH, self->width );
+        glTexSubImage2D( GL_TEXTURE_2D, 0, x, y,
+                         self->dirty.x1 - x, self->dirty.y1 - y,
+                         format, type,
+                         self->data + (y*self->width + x) * self->depth );
+        glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+        glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+    }
+
+    self->dirty.x0 = self->dirty.x1 = 0;
+    self->dirty.y0 = self->dirty.y1 = 0;
+}
+
 /* vim: set expandtab sw=4 ts=4 :*/
@@ -138,6 +138,44 @@ typedef struct
      */
     unsigned char * data;
 
+    /**
+     * Most bytes of data the atlas may grow to
+     */
+    size_t budget;
+
+    /**
+     * Bumped whenever regions move or are thrown away, so that anything
+     * holding on to texture coordinates knows to fetch them again
+     */
+    unsigned int generation;
+
+    /**
+     * Ticks on every glyph lookup, used to find least recently used glyphs
+     */
+    size_t clock;
+
+    /**
+     * Bounds of the data that changed since the last upload (empty when
+     * x1 <= x0)
+     */
+    struct {
+        size_t x0, y0;
+        size_t x1, y1;
+    } dirty;
+
+    /**
+     * Size the texture was last allocated at (zero before the first upload)
+     */
+    struct {
+        size_t width;
+        size_t height;
+    } texture;
+
+    /**
+     * Fonts whose glyphs live in this atlas
+     */
+    vector_t * fonts;
+
 } texture_atlas_t;
 
 
@@ -170,7 +208,8 @@ typedef struct
 
 
 /**
- *  Upload atlas to video memory.
+ *  Upload atlas to video memory. Only the part that changed since the last
+ *  upload is sent, unless the atlas has grown since.
  *
  *  @param self a texture atlas structure
  *
@@ -215,6 +254,17 @@ typedef struct
                             const unsigned char *data,
                             const size_t stride );
 
+/**
+ *  Double the atlas in one direction, keeping every region where it is.
+ *  The texture coordinates of existing regions change as a result.
+ *
+ *  @param self   a texture atlas structure
+ *  @return       0 on success, -1 if growing would go over the budget or
+ *                the largest texture size the GL allows
+ */
+  int
+  texture_atlas_grow( texture_atlas_t * self );
+
 /**
  *  Remove all allocated regions from the atlas.
  *
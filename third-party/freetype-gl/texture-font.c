@@ -42,6 +42,7 @@
 #include <assert.h>
 #include <math.h>
 #include "texture-font.h"
+#include "distance-field.h"
 
 #define HRES  64
 #define HRESf 64.f
@@ -57,7 +58,7 @@ const struct {
 #include FT_ERRORS_H
 
 static int
-texture_font_load_face(texture_font_t *self, float size,
+texture_font_load_face(const texture_font_t *self, float size,
 		FT_Library *library, FT_Face *face)
 {
 	FT_Error error;
@@ -127,25 +128,37 @@ texture_font_load_face(texture_font_t *self, float size,
 }
 
 static int
-texture_font_get_face_with_size(texture_font_t *self, float size,
+texture_font_get_face_with_size(const texture_font_t *self, float size,
 		FT_Library *library, FT_Face *face)
 {
 	return texture_font_load_face(self, size, library, face);
 }
 
 static int
-texture_font_get_face(texture_font_t *self,
+texture_font_get_face(const texture_font_t *self,
 		FT_Library *library, FT_Face *face)
 {
 	return texture_font_get_face_with_size(self, self->size, library, face);
 }
 
+/* metrics are read from the face scaled up by this much, for the precision
+ * that FreeType's whole pixel metrics don't have. FreeType won't go past
+ * 0xFFFF pixels per em though, which large fonts at a high dpi would. */
+static float
+texture_font_hires_scale(const texture_font_t *self)
+{
+	float limit = floorf((0xFFFF * 72.f) /
+			(self->size * self->atlas->dpi.x * HRESf));
+
+	return fmaxf(1.f, fminf(100.f, limit));
+}
+
 static int
-texture_font_get_hires_face(texture_font_t *self,
+texture_font_get_hires_face(const texture_font_t *self,
 		FT_Library *library, FT_Face *face)
 {
 	return texture_font_get_face_with_size(self,
-			self->size * 100.f, library, face);
+			self->size * texture_font_hires_scale(self), library, face);
 }
 
 // ------------------------------------------------------ texture_glyph_new ---
@@ -172,6 +185,8 @@ texture_glyph_new(void)
 	self->t0        = 0.0;
 	self->s1        = 0.0;
 	self->t1        = 0.0;
+	self->region    = (ivec4) {{0, 0, 0, 0}};
+	self->last_use  = 0;
 	self->kerning   = vector_new( sizeof(kerning_t) );
 	return self;
 }
@@ -251,6 +266,395 @@ texture_font_generate_kerning(texture_font_t *self)
     FT_Done_FreeType( library );
 }
 
+// ------------------------------------------------------------ glyph table ---
+#define GLYPH_TABLE_MIN_CAPACITY 64
+
+/* charcode -1 matches regardless of outline, so it always hashes and
+ * compares as if it had none. */
+static int
+glyph_matches( const texture_glyph_t * glyph, int32_t charcode,
+               int outline_type, float outline_thickness )
+{
+    if( glyph->charcode != charcode )
+        return 0;
+
+    return charcode == (int32_t)(-1)
+        || ((glyph->outline_type == outline_type) &&
+            (glyph->outline_thickness == outline_thickness));
+}
+
+static size_t
+glyph_hash( int32_t charcode, int outline_type, float outline_thickness )
+{
+    union { float f; uint32_t u; } thickness = { outline_thickness };
+    uint32_t h;
+
+    if( charcode == (int32_t)(-1) )
+    {
+        outline_type = 0;
+        thickness.u = 0;
+    }
+
+    h  = (uint32_t) charcode * 0x9e3779b1u;
+    h ^= ((uint32_t) outline_type * 0x85ebca77u) ^ (thickness.u * 0xc2b2ae3du);
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 13;
+
+    return h;
+}
+
+static void
+glyph_table_put( texture_font_t * self, texture_glyph_t * glyph )
+{
+    size_t mask = self->glyph_table.capacity - 1;
+    size_t i = glyph_hash( glyph->charcode, glyph->outline_type,
+                           glyph->outline_thickness ) & mask;
+
+    while( self->glyph_table.slots[i] )
+        i = (i + 1) & mask;
+
+    self->glyph_table.slots[i] = glyph;
+    self->glyph_table.count++;
+}
+
+/* rebuilds the table from the glyph vector, which owns the glyphs. */
+static int
+glyph_table_resize( texture_font_t * self, size_t capacity )
+{
+    texture_glyph_t **slots;
+    size_t i;
+
+    slots = calloc( capacity, sizeof(*slots) );
+    if( !slots )
+        return -1;
+
+    free( self->glyph_table.slots );
+    self->glyph_table.slots = slots;
+    self->glyph_table.capacity = capacity;
+    self->glyph_table.count = 0;
+
+    for( i=0; i<self->glyphs->size; ++i )
+        glyph_table_put( self,
+                         *(texture_glyph_t **) vector_get( self->glyphs, i ) );
+
+    return 0;
+}
+
+/* called once `glyph` has been pushed onto the glyph vector. if the table
+ * can't grow, it's dropped, and lookups go back to scanning the vector. */
+static void
+glyph_table_add( texture_font_t * self, texture_glyph_t * glyph )
+{
+    size_t capacity = self->glyph_table.capacity;
+
+    if( glyph->charcode >= 0 && glyph->charcode < 256 )
+        self->latin1[glyph->charcode] = glyph;
+
+    /* keep the load factor at or below a half. */
+    if( (self->glyph_table.count + 1) * 2 > capacity )
+    {
+        capacity = capacity ? capacity * 2 : GLYPH_TABLE_MIN_CAPACITY;
+
+        if( glyph_table_resize( self, capacity ) )
+        {
+            free( self->glyph_table.slots );
+            self->glyph_table.slots = NULL;
+            self->glyph_table.capacity = 0;
+            self->glyph_table.count = 0;
+        }
+
+        /* the rebuild picked up the new glyph along with the rest. */
+        return;
+    }
+
+    glyph_table_put( self, glyph );
+}
+
+static texture_glyph_t *
+glyph_table_find( texture_font_t * self, int32_t charcode )
+{
+    texture_glyph_t *glyph;
+    size_t i, mask;
+
+    if( charcode >= 0 && charcode < 256 )
+    {
+        glyph = self->latin1[charcode];
+
+        if( glyph && glyph_matches( glyph, charcode, self->outline_type,
+                                    self->outline_thickness ) )
+            return glyph;
+    }
+
+    if( !self->glyph_table.slots )
+    {
+        for( i=0; i<self->glyphs->size; ++i )
+        {
+            glyph = *(texture_glyph_t **) vector_get( self->glyphs, i );
+
+            if( glyph_matches( glyph, charcode, self->outline_type,
+                               self->outline_thickness ) )
+                return glyph;
+        }
+
+        return NULL;
+    }
+
+    mask = self->glyph_table.capacity - 1;
+    i = glyph_hash( charcode, self->outline_type,
+                    self->outline_thickness ) & mask;
+
+    for( ; (glyph = self->glyph_table.slots[i]); i = (i + 1) & mask )
+    {
+        if( !glyph_matches( glyph, charcode, self->outline_type,
+                            self->outline_thickness ) )
+            continue;
+
+        /* the outline parameters may have changed since the latin1 entry
+         * was filled in, so point it at whatever was asked for last. */
+        if( charcode >= 0 && charcode < 256 )
+            self->latin1[charcode] = glyph;
+
+        return glyph;
+    }
+
+    return NULL;
+}
+
+static void
+glyph_table_rebuild( texture_font_t * self )
+{
+    memset( self->latin1, 0, sizeof(self->latin1) );
+
+    if( !self->glyph_table.slots )
+        return;
+
+    if( glyph_table_resize( self, self->glyph_table.capacity ) )
+    {
+        free( self->glyph_table.slots );
+        self->glyph_table.slots = NULL;
+        self->glyph_table.capacity = 0;
+        self->glyph_table.count = 0;
+    }
+}
+
+// ------------------------------------------------------------ atlas space ---
+
+/* the -1 glyph samples from the middle of its 4x4 block, everything else
+ * from the top left of its region. */
+static void
+glyph_set_texcoords( texture_glyph_t * glyph, const texture_atlas_t * atlas )
+{
+    float x = glyph->region.x, y = glyph->region.y;
+    float w = glyph->width, h = glyph->height;
+
+    if( glyph->charcode == (int32_t)(-1) )
+    {
+        x += 2;
+        y += 2;
+        w = h = 1;
+    }
+
+    glyph->s0 = x/(float)atlas->width;
+    glyph->t0 = y/(float)atlas->height;
+    glyph->s1 = (x + w)/(float)atlas->width;
+    glyph->t1 = (y + h)/(float)atlas->height;
+}
+
+/* every glyph in the atlas, across all of its fonts. */
+static texture_glyph_t **
+atlas_collect_glyphs( texture_atlas_t * atlas, size_t * count )
+{
+    texture_glyph_t **glyphs;
+    texture_font_t *font;
+    size_t i, j, n = 0;
+
+    for( i=0; i<vector_size(atlas->fonts); ++i )
+    {
+        font = *(texture_font_t **) vector_get( atlas->fonts, i );
+        n += vector_size( font->glyphs );
+    }
+
+    if( !(glyphs = malloc( (n ? n : 1) * sizeof(*glyphs) )) )
+        return NULL;
+
+    for( n=0, i=0; i<vector_size(atlas->fonts); ++i )
+    {
+        font = *(texture_font_t **) vector_get( atlas->fonts, i );
+
+        for( j=0; j<vector_size(font->glyphs); ++j )
+            glyphs[n++] = *(texture_glyph_t **) vector_get( font->glyphs, j );
+    }
+
+    *count = n;
+    return glyphs;
+}
+
+/* after the atlas has grown, every region is where it was, but the texture
+ * coordinates have to be scaled down to match. */
+static void
+atlas_relocate( texture_atlas_t * atlas )
+{
+    texture_font_t *font;
+    size_t i, j;
+
+    for( i=0; i<vector_size(atlas->fonts); ++i )
+    {
+        font = *(texture_font_t **) vector_get( atlas->fonts, i );
+
+        for( j=0; j<vector_size(font->glyphs); ++j )
+            glyph_set_texcoords(
+                *(texture_glyph_t **) vector_get( font->glyphs, j ), atlas );
+    }
+}
+
+/* the -1 glyph is pinned, since fonts expect it to always be there. */
+static size_t
+glyph_recency( const texture_glyph_t * glyph )
+{
+    return glyph->charcode == (int32_t)(-1) ? (size_t) -1 : glyph->last_use;
+}
+
+static int
+by_recency( const void * _a, const void * _b )
+{
+    size_t a = glyph_recency( *(texture_glyph_t * const *) _a );
+    size_t b = glyph_recency( *(texture_glyph_t * const *) _b );
+
+    return (a < b) - (a > b);
+}
+
+static int
+by_height( const void * _a, const void * _b )
+{
+    const texture_glyph_t *a = *(texture_glyph_t * const *) _a;
+    const texture_glyph_t *b = *(texture_glyph_t * const *) _b;
+
+    if( a->region.height != b->region.height )
+        return b->region.height - a->region.height;
+
+    return b->region.width - a->region.width;
+}
+
+/* keeps the most recently used glyphs that fit in half of the atlas and
+ * throws away the rest. the survivors are packed again from scratch, with
+ * their pixels copied across from a snapshot of the old atlas data.
+ * returns how many glyphs were thrown away. */
+static size_t
+atlas_evict( texture_atlas_t * atlas )
+{
+    size_t i, j, count, kept, area, budget, stride, evicted = 0;
+    texture_glyph_t **glyphs, *glyph;
+    texture_font_t *font;
+    unsigned char *old;
+    ivec4 region;
+
+    if( !(glyphs = atlas_collect_glyphs( atlas, &count )) )
+        return 0;
+
+    stride = atlas->width * atlas->depth;
+    if( !(old = malloc( stride * atlas->height )) )
+    {
+        free( glyphs );
+        return 0;
+    }
+
+    memcpy( old, atlas->data, stride * atlas->height );
+
+    qsort( glyphs, count, sizeof(*glyphs), by_recency );
+
+    budget = (atlas->width - 2) * (atlas->height - 2) / 2;
+    for( kept=0, area=0; kept<count; ++kept )
+    {
+        glyph = glyphs[kept];
+        area += glyph->region.width * glyph->region.height;
+
+        if( area > budget && glyph->charcode != (int32_t)(-1) )
+            break;
+    }
+
+    /* a region width of zero marks a glyph for deletion below. */
+    for( i=kept; i<count; ++i )
+        glyphs[i]->region.width = 0;
+
+    qsort( glyphs, kept, sizeof(*glyphs), by_height );
+    texture_atlas_clear( atlas );
+
+    for( i=0; i<kept; ++i )
+    {
+        glyph = glyphs[i];
+        region = texture_atlas_get_region( atlas,
+                glyph->region.width, glyph->region.height );
+
+        if( region.x < 0 )
+        {
+            glyph->region.width = 0;
+            continue;
+        }
+
+        texture_atlas_set_region( atlas, region.x, region.y,
+                region.width - 1, region.height - 1,
+                old + glyph->region.y * stride
+                    + glyph->region.x * atlas->depth,
+                stride );
+
+        glyph->region = region;
+        glyph_set_texcoords( glyph, atlas );
+    }
+
+    for( i=0; i<vector_size(atlas->fonts); ++i )
+    {
+        font = *(texture_font_t **) vector_get( atlas->fonts, i );
+
+        for( count=0, j=0; j<vector_size(font->glyphs); ++j )
+        {
+            glyph = *(texture_glyph_t **) vector_get( font->glyphs, j );
+
+            if( glyph->region.width )
+                vector_set( font->glyphs, count++, &glyph );
+            else
+            {
+                texture_glyph_delete( glyph );
+                evicted++;
+            }
+        }
+
+        vector_resize( font->glyphs, count );
+        glyph_table_rebuild( font );
+    }
+
+    free( old );
+    free( glyphs );
+    return evicted;
+}
+
+/* finds room for a region, first by growing the atlas within its budget,
+ * then by throwing out the least recently used glyphs. */
+static ivec4
+texture_font_get_region( texture_font_t * self,
+                         const size_t width,
+                         const size_t height )
+{
+    texture_atlas_t *atlas = self->atlas;
+    ivec4 region;
+
+    region = texture_atlas_get_region( atlas, width, height );
+
+    while( region.x < 0 && !texture_atlas_grow( atlas ) )
+    {
+        atlas_relocate( atlas );
+        region = texture_atlas_get_region( atlas, width, height );
+    }
+
+    /* no point clearing out the atlas for something that can never fit. */
+    if( region.x < 0
+        && width <= atlas->width - 2 && height <= atlas->height - 2
+        && atlas_evict( atlas ) )
+        region = texture_atlas_get_region( atlas, width, height );
+
+    return region;
+}
+
 // ------------------------------------------------------ texture_font_init ---
 
 static int
@@ -259,6 +663,7 @@ texture_font_init(texture_font_t *self)
 	FT_Library library;
 	FT_Face face;
 	FT_Size_Metrics metrics;
+	float scale;
 
 	assert(self->atlas);
 	assert(self->size > 0);
@@ -267,6 +672,7 @@ texture_font_init(texture_font_t *self)
 			&& self->memory.base && self->memory.size));
 
 	self->glyphs = vector_new(sizeof(texture_glyph_t *));
+	vector_push_back(self->atlas->fonts, &self);
 	self->height = 0;
 	self->ascender = 0;
 	self->descender = 0;
@@ -301,9 +707,10 @@ texture_font_init(texture_font_t *self)
 		self->underline_thickness = 1.0;
 
 	metrics = face->size->metrics;
-	self->ascender = (metrics.ascender >> 6) / 100.0;
-	self->descender = (metrics.descender >> 6) / 100.0;
-	self->height = (metrics.height >> 6) / 100.0;
+	scale = texture_font_hires_scale(self);
+	self->ascender = (metrics.ascender >> 6) / scale;
+	self->descender = (metrics.descender >> 6) / scale;
+	self->height = (metrics.height >> 6) / scale;
 	self->linegap = self->height - self->ascender + self->descender;
 
 	FT_Done_Face(face);
@@ -385,6 +792,13 @@ texture_font_delete(texture_font_t *self)
 
     assert(self);
 
+    for(i=0; i < vector_size(self->atlas->fonts); ++i) {
+        if(*(texture_font_t **) vector_get(self->atlas->fonts, i) == self) {
+            vector_erase(self->atlas->fonts, i);
+            break;
+        }
+    }
+
     if(self->location == TEXTURE_FONT_FILE && self->filename)
         free( self->filename );
 
@@ -394,10 +808,190 @@ texture_font_delete(texture_font_t *self)
     }
 
     vector_delete(self->glyphs);
+    free(self->glyph_table.slots);
     free(self);
 }
 
-// ----------------------------------------------- texture_font_load_glyphs ---
+// ------------------------------------------------------- rasterize_glyph ---
+// Renders one glyph with FreeType into `bitmap`. Only reads `self`, so that
+// it can run on any thread with its own library and face.
+static int
+rasterize_glyph( const texture_font_t * self, FT_Library library,
+                 FT_Face face, int32_t charcode,
+                 texture_glyph_bitmap_t * bitmap )
+{
+    size_t depth = self->atlas->depth;
+    size_t row, row_size;
+    FT_Error error;
+    FT_Glyph ft_glyph = NULL;
+    FT_GlyphSlot slot;
+    FT_Bitmap ft_bitmap;
+    FT_UInt glyph_index;
+    FT_Int32 flags = 0;
+    unsigned char *field;
+    int ft_bitmap_width = 0;
+    int ft_bitmap_rows = 0;
+    int ft_bitmap_pitch = 0;
+    int ft_glyph_top = 0;
+    int ft_glyph_left = 0;
+
+    glyph_index = FT_Get_Char_Index( face, charcode );
+    // WARNING: We use texture-atlas depth to guess if user wants
+    //          LCD subpixel rendering
+
+    if( self->outline_type > 0 )
+        flags |= FT_LOAD_NO_BITMAP;
+    else
+        flags |= FT_LOAD_RENDER;
+
+    if (!self->hinting)
+        flags |= FT_LOAD_NO_HINTING | FT_LOAD_NO_AUTOHINT;
+    else
+        flags |= FT_LOAD_FORCE_AUTOHINT;
+
+    if( depth == 3 )
+    {
+        FT_Library_SetLcdFilter( library, FT_LCD_FILTER_LIGHT );
+        flags |= FT_LOAD_TARGET_LCD;
+
+        if( self->filtering )
+        {
+            FT_Library_SetLcdFilterWeights( library,
+                                            (unsigned char *) self->lcd_weights );
+        }
+    }
+
+    error = FT_Load_Glyph( face, glyph_index, flags );
+    if( error )
+    {
+        fprintf( stderr, "FT_Error (line %d, code 0x%02x) : %s\n",
+                 __LINE__, FT_Errors[error].code, FT_Errors[error].message );
+        return -1;
+    }
+
+
+    if( self->outline_type == 0 )
+    {
+        slot            = face->glyph;
+        ft_bitmap       = slot->bitmap;
+        ft_bitmap_width = slot->bitmap.width;
+        ft_bitmap_rows  = slot->bitmap.rows;
+        ft_bitmap_pitch = slot->bitmap.pitch;
+        ft_glyph_top    = slot->bitmap_top;
+        ft_glyph_left   = slot->bitmap_left;
+    }
+    else
+    {
+        FT_Stroker stroker;
+        FT_BitmapGlyph ft_bitmap_glyph;
+        error = FT_Stroker_New( library, &stroker );
+        if( error )
+        {
+            fprintf(stderr, "FT_Error (0x%02x) : %s\n",
+                    FT_Errors[error].code, FT_Errors[error].message);
+            return -1;
+        }
+        FT_Stroker_Set(stroker,
+                        (int)(self->outline_thickness * 64),
+                        FT_STROKER_LINECAP_ROUND,
+                        FT_STROKER_LINEJOIN_ROUND,
+                        0);
+        error = FT_Get_Glyph( face->glyph, &ft_glyph);
+        if( error )
+        {
+            fprintf(stderr, "FT_Error (0x%02x) : %s\n",
+                    FT_Errors[error].code, FT_Errors[error].message);
+            FT_Stroker_Done( stroker );
+            return -1;
+        }
+
+        if( self->outline_type == 1 )
+        {
+            error = FT_Glyph_Stroke( &ft_glyph, stroker, 1 );
+        }
+        else if ( self->outline_type == 2 )
+        {
+            error = FT_Glyph_StrokeBorder( &ft_glyph, stroker, 0, 1 );
+        }
+        else if ( self->outline_type == 3 )
+        {
+            error = FT_Glyph_StrokeBorder( &ft_glyph, stroker, 1, 1 );
+        }
+
+        if( !error )
+        {
+            error = FT_Glyph_To_Bitmap( &ft_glyph, depth == 1
+                                        ? FT_RENDER_MODE_NORMAL
+                                        : FT_RENDER_MODE_LCD, 0, 1);
+        }
+
+        FT_Stroker_Done(stroker);
+
+        if( error )
+        {
+            fprintf(stderr, "FT_Error (0x%02x) : %s\n",
+                    FT_Errors[error].code, FT_Errors[error].message);
+            FT_Done_Glyph( ft_glyph );
+            return -1;
+        }
+
+        ft_bitmap_glyph = (FT_BitmapGlyph) ft_glyph;
+        ft_bitmap       = ft_bitmap_glyph->bitmap;
+        ft_bitmap_width = ft_bitmap.width;
+        ft_bitmap_rows  = ft_bitmap.rows;
+        ft_bitmap_pitch = ft_bitmap.pitch;
+        ft_glyph_top    = ft_bitmap_glyph->top;
+        ft_glyph_left   = ft_bitmap_glyph->left;
+    }
+
+    bitmap->charcode = charcode;
+    bitmap->width    = ft_bitmap_width / depth;
+    bitmap->height   = ft_bitmap_rows;
+    bitmap->offset_x = ft_glyph_left;
+    bitmap->offset_y = ft_glyph_top;
+
+    // A distance field reaches out past the glyph's coverage, so it
+    // takes up more room on every side.
+    if( self->distance_field && depth == 1
+        && ft_bitmap_width > 0 && ft_bitmap_rows > 0 )
+    {
+        int spread = self->distance_field;
+
+        field = make_distance_field( ft_bitmap.buffer, ft_bitmap_width,
+                                     ft_bitmap_rows, ft_bitmap_pitch,
+                                     spread );
+        bitmap->buffer    = field;
+        bitmap->width    += 2 * spread;
+        bitmap->height   += 2 * spread;
+        bitmap->offset_x -= spread;
+        bitmap->offset_y += spread;
+    }
+    else
+    {
+        row_size = bitmap->width * depth;
+        bitmap->buffer = malloc( row_size * bitmap->height + 1 );
+
+        for( row = 0; bitmap->buffer && row < bitmap->height; ++row )
+            memcpy( bitmap->buffer + row * row_size,
+                    ft_bitmap.buffer + row * ft_bitmap_pitch, row_size );
+    }
+
+    if( ft_glyph )
+        FT_Done_Glyph( ft_glyph );
+
+    if( !bitmap->buffer )
+        return -1;
+
+    // Discard hinting to get advance
+    FT_Load_Glyph( face, glyph_index, FT_LOAD_RENDER | FT_LOAD_NO_HINTING);
+    slot = face->glyph;
+    bitmap->advance_x = slot->advance.x / HRESf;
+    bitmap->advance_y = slot->advance.y / HRESf;
+
+    return 0;
+}
+
+// ----------------------------------------------------------------- i32len ---
 static size_t
 i32len(const int32_t *s)
 {
@@ -407,246 +1001,160 @@ i32len(const int32_t *s)
 	return len;
 }
 
-size_t
-texture_font_load_glyphs( texture_font_t * self,
-                          const int32_t * charcodes )
+// ------------------------------------------ texture_font_rasterize_glyphs ---
+vector_t *
+texture_font_rasterize_glyphs( const texture_font_t * self,
+                               const int32_t * charcodes )
 {
-    size_t i, x, y, width, height, depth, w, h;
+    texture_glyph_bitmap_t bitmap;
+    vector_t *bitmaps;
     FT_Library library;
-    FT_Error error;
     FT_Face face;
-    FT_Glyph ft_glyph;
-    FT_GlyphSlot slot;
-    FT_Bitmap ft_bitmap;
-
-    FT_UInt glyph_index;
-    texture_glyph_t *glyph;
-    ivec4 region;
-    size_t missed = 0, len;
+    size_t i;
 
     assert( self );
     assert( charcodes );
 
+    bitmaps = vector_new( sizeof(texture_glyph_bitmap_t) );
+    if( !bitmaps )
+        return NULL;
 
-    width  = self->atlas->width;
-    height = self->atlas->height;
-    depth  = self->atlas->depth;
-	len = i32len(charcodes);
+    if( !texture_font_get_face( self, &library, &face ) )
+        return bitmaps;
 
-	if (!texture_font_get_face(self, &library, &face))
-		return len;
-
-    /* Load each glyph */
-    for( i=0; charcodes[i]; ++i )
+    for( i = 0; charcodes[i]; ++i )
     {
-        FT_Int32 flags = 0;
-        int ft_bitmap_width = 0;
-        int ft_bitmap_rows = 0;
-        int ft_bitmap_pitch = 0;
-        int ft_glyph_top = 0;
-        int ft_glyph_left = 0;
-        glyph_index = FT_Get_Char_Index( face, charcodes[i] );
-        // WARNING: We use texture-atlas depth to guess if user wants
-        //          LCD subpixel rendering
-
-        if( self->outline_type > 0 )
-            flags |= FT_LOAD_NO_BITMAP;
-        else
-            flags |= FT_LOAD_RENDER;
-
-        if (!self->hinting)
-            flags |= FT_LOAD_NO_HINTING | FT_LOAD_NO_AUTOHINT;
-		else
-			flags |= FT_LOAD_FORCE_AUTOHINT;
-
-        if( depth == 3 )
-        {
-            FT_Library_SetLcdFilter( library, FT_LCD_FILTER_LIGHT );
-            flags |= FT_LOAD_TARGET_LCD;
-
-            if( self->filtering )
-            {
-                FT_Library_SetLcdFilterWeights( library, self->lcd_weights );
-            }
-        }
+        if( rasterize_glyph( self, library, face, charcodes[i], &bitmap ) )
+            break;
 
-        error = FT_Load_Glyph( face, glyph_index, flags );
-        if( error )
-        {
-            fprintf( stderr, "FT_Error (line %d, code 0x%02x) : %s\n",
-                     __LINE__, FT_Errors[error].code, FT_Errors[error].message );
-            FT_Done_Face( face );
-            FT_Done_FreeType( library );
-            return len - i;
-        }
+        vector_push_back( bitmaps, &bitmap );
+    }
 
+    FT_Done_Face( face );
+    FT_Done_FreeType( library );
+    return bitmaps;
+}
 
-        if( self->outline_type == 0 )
-        {
-            slot            = face->glyph;
-            ft_bitmap       = slot->bitmap;
-            ft_bitmap_width = slot->bitmap.width;
-            ft_bitmap_rows  = slot->bitmap.rows;
-            ft_bitmap_pitch = slot->bitmap.pitch;
-            ft_glyph_top    = slot->bitmap_top;
-            ft_glyph_left   = slot->bitmap_left;
-        }
-        else
-        {
-            FT_Stroker stroker;
-            FT_BitmapGlyph ft_bitmap_glyph;
-            error = FT_Stroker_New( library, &stroker );
-            if( error )
-            {
-                fprintf(stderr, "FT_Error (0x%02x) : %s\n",
-                        FT_Errors[error].code, FT_Errors[error].message);
-                FT_Done_Face( face );
-                FT_Stroker_Done( stroker );
-                FT_Done_FreeType( library );
-                return 0;
-            }
-            FT_Stroker_Set(stroker,
-                            (int)(self->outline_thickness * 64),
-                            FT_STROKER_LINECAP_ROUND,
-                            FT_STROKER_LINEJOIN_ROUND,
-                            0);
-            error = FT_Get_Glyph( face->glyph, &ft_glyph);
-            if( error )
-            {
-                fprintf(stderr, "FT_Error (0x%02x) : %s\n",
-                        FT_Errors[error].code, FT_Errors[error].message);
-                FT_Done_Face( face );
-                FT_Stroker_Done( stroker );
-                FT_Done_FreeType( library );
-                return 0;
-            }
+// ------------------------------------------------ texture_font_add_glyphs ---
+size_t
+texture_font_add_glyphs( texture_font_t * self, const vector_t * bitmaps )
+{
+    const texture_glyph_bitmap_t *bitmap;
+    texture_glyph_t *glyph;
+    size_t i, added = 0;
+    ivec4 region;
 
-            if( self->outline_type == 1 )
-            {
-                error = FT_Glyph_Stroke( &ft_glyph, stroker, 1 );
-            }
-            else if ( self->outline_type == 2 )
-            {
-                error = FT_Glyph_StrokeBorder( &ft_glyph, stroker, 0, 1 );
-            }
-            else if ( self->outline_type == 3 )
-            {
-                error = FT_Glyph_StrokeBorder( &ft_glyph, stroker, 1, 1 );
-            }
-            if( error )
-            {
-                fprintf(stderr, "FT_Error (0x%02x) : %s\n",
-                        FT_Errors[error].code, FT_Errors[error].message);
-                FT_Done_Face( face );
-                FT_Stroker_Done( stroker );
-                FT_Done_FreeType( library );
-                return 0;
-            }
+    assert( self );
+    assert( bitmaps );
 
-            if( depth == 1)
-            {
-                error = FT_Glyph_To_Bitmap( &ft_glyph, FT_RENDER_MODE_NORMAL, 0, 1);
-                if( error )
-                {
-                    fprintf(stderr, "FT_Error (0x%02x) : %s\n",
-                            FT_Errors[error].code, FT_Errors[error].message);
-                    FT_Done_Face( face );
-                    FT_Stroker_Done( stroker );
-                    FT_Done_FreeType( library );
-                    return 0;
-                }
-            }
-            else
-            {
-                error = FT_Glyph_To_Bitmap( &ft_glyph, FT_RENDER_MODE_LCD, 0, 1);
-                if( error )
-                {
-                    fprintf(stderr, "FT_Error (0x%02x) : %s\n",
-                            FT_Errors[error].code, FT_Errors[error].message);
-                    FT_Done_Face( face );
-                    FT_Stroker_Done( stroker );
-                    FT_Done_FreeType( library );
-                    return 0;
-                }
-            }
-            ft_bitmap_glyph = (FT_BitmapGlyph) ft_glyph;
-            ft_bitmap       = ft_bitmap_glyph->bitmap;
-            ft_bitmap_width = ft_bitmap.width;
-            ft_bitmap_rows  = ft_bitmap.rows;
-            ft_bitmap_pitch = ft_bitmap.pitch;
-            ft_glyph_top    = ft_bitmap_glyph->top;
-            ft_glyph_left   = ft_bitmap_glyph->left;
-            FT_Stroker_Done(stroker);
-        }
+    for( i = 0; i < vector_size( bitmaps ); ++i )
+    {
+        bitmap = vector_get( bitmaps, i );
 
+        // Might have been loaded by someone else since it was rasterized.
+        if( glyph_table_find( self, bitmap->charcode ) )
+            continue;
 
         // We want each glyph to be separated by at least one black pixel
         // (for example for shader used in demo-subpixel.c)
-        w = ft_bitmap_width/depth + 1;
-        h = ft_bitmap_rows + 1;
-        region = texture_atlas_get_region( self->atlas, w, h );
+        region = texture_font_get_region( self, bitmap->width + 1,
+                                          bitmap->height + 1 );
         if ( region.x < 0 )
         {
-            missed++;
             fprintf( stderr, "Texture atlas is full (line %d)\n",  __LINE__ );
             continue;
         }
-        w = w - 1;
-        h = h - 1;
-        x = region.x;
-        y = region.y;
-        texture_atlas_set_region( self->atlas, x, y, w, h,
-                                  ft_bitmap.buffer, ft_bitmap.pitch );
 
-        glyph = texture_glyph_new();
+        texture_atlas_set_region( self->atlas, region.x, region.y,
+                                  bitmap->width, bitmap->height,
+                                  bitmap->buffer,
+                                  bitmap->width * self->atlas->depth );
 
-		if (!glyph) {
-			missed = len - i;
-			break;
-		}
+        glyph = texture_glyph_new();
+        if (!glyph)
+            break;
 
-        glyph->charcode = charcodes[i];
-        glyph->width    = w;
-        glyph->height   = h;
+        glyph->charcode = bitmap->charcode;
+        glyph->width    = bitmap->width;
+        glyph->height   = bitmap->height;
         glyph->outline_type = self->outline_type;
         glyph->outline_thickness = self->outline_thickness;
-        glyph->offset_x = ft_glyph_left;
-        glyph->offset_y = ft_glyph_top;
-        glyph->s0       = x/(float)width;
-        glyph->t0       = y/(float)height;
-        glyph->s1       = (x + glyph->width)/(float)width;
-        glyph->t1       = (y + glyph->height)/(float)height;
-
-        // Discard hinting to get advance
-        FT_Load_Glyph( face, glyph_index, FT_LOAD_RENDER | FT_LOAD_NO_HINTING);
-        slot = face->glyph;
-        glyph->advance_x = slot->advance.x / HRESf;
-        glyph->advance_y = slot->advance.y / HRESf;
+        glyph->offset_x = bitmap->offset_x;
+        glyph->offset_y = bitmap->offset_y;
+        glyph->advance_x = bitmap->advance_x;
+        glyph->advance_y = bitmap->advance_y;
+        glyph->region   = region;
+        glyph->last_use = ++self->atlas->clock;
+        glyph_set_texcoords( glyph, self->atlas );
 
         vector_push_back( self->glyphs, &glyph );
+        glyph_table_add( self, glyph );
+        added++;
+    }
 
-        if( self->outline_type > 0 )
-        {
-            FT_Done_Glyph( ft_glyph );
-        }
-
-		((void) ft_bitmap_pitch); /* shut up, gcc */
+    if( added )
+    {
+        texture_atlas_upload( self->atlas );
+        texture_font_generate_kerning( self );
     }
 
-    FT_Done_Face( face );
-    FT_Done_FreeType( library );
-    texture_atlas_upload( self->atlas );
-    texture_font_generate_kerning( self );
+    return added;
+}
+
+// -------------------------------------------- texture_glyph_bitmaps_delete ---
+void
+texture_glyph_bitmaps_delete( vector_t * bitmaps )
+{
+    size_t i;
+
+    for( i = 0; i < vector_size( bitmaps ); ++i )
+        free( ((texture_glyph_bitmap_t *) vector_get( bitmaps, i ))->buffer );
+
+    vector_delete( bitmaps );
+}
+
+// ----------------------------------------------- texture_font_load_glyphs ---
+size_t
+texture_font_load_glyphs( texture_font_t * self,
+                          const int32_t * charcodes )
+{
+    vector_t *bitmaps;
+    size_t missed;
+
+    assert( self );
+    assert( charcodes );
+
+    bitmaps = texture_font_rasterize_glyphs( self, charcodes );
+    if( !bitmaps )
+        return i32len( charcodes );
+
+    texture_font_add_glyphs( self, bitmaps );
+    texture_glyph_bitmaps_delete( bitmaps );
+
+    for( missed = 0; *charcodes; ++charcodes )
+        if( !glyph_table_find( self, *charcodes ) )
+            missed++;
+
     return missed;
 }
 
 
+// ------------------------------------------------ texture_font_find_glyph ---
+texture_glyph_t *
+texture_font_find_glyph( texture_font_t * self,
+                         int32_t charcode )
+{
+    assert( self );
+
+    return glyph_table_find( self, charcode );
+}
+
+
 // ------------------------------------------------- texture_font_get_glyph ---
 texture_glyph_t *
 texture_font_get_glyph( texture_font_t * self,
                         int32_t charcode )
 {
-    size_t i;
     int32_t buffer[2] = {0,0};
     texture_glyph_t *glyph;
 
@@ -657,17 +1165,10 @@ texture_font_get_glyph( texture_font_t * self,
     assert( self->atlas );
 
     /* Check if charcode has been already loaded */
-    for( i=0; i<self->glyphs->size; ++i )
+    if( (glyph = glyph_table_find( self, charcode )) )
     {
-        glyph = *(texture_glyph_t **) vector_get( self->glyphs, i );
-        // If charcode is -1, we don't care about outline type or thickness
-        if( (glyph->charcode == charcode) &&
-            ((charcode == (int32_t)(-1) ) ||
-             ((glyph->outline_type == self->outline_type) &&
-              (glyph->outline_thickness == self->outline_thickness)) ))
-        {
-            return glyph;
-        }
+        glyph->last_use = ++self->atlas->clock;
+        return glyph;
     }
 
     /* charcode -1 is special : it is used for line drawing (overline,
@@ -675,10 +1176,7 @@ texture_font_get_glyph( texture_font_t * self,
      */
     if( charcode == (int32_t)(-1) )
     {
-        size_t width  = self->atlas->width;
-        size_t height = self->atlas->height;
-        ivec4 region = texture_atlas_get_region( self->atlas, 5, 5 );
-        texture_glyph_t * glyph = texture_glyph_new( );
+        ivec4 region = texture_font_get_region( self, 5, 5 );
         static unsigned char data[4*4*3] = {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
                                             -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
                                             -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
@@ -688,13 +1186,14 @@ texture_font_get_glyph( texture_font_t * self,
             fprintf( stderr, "Texture atlas is full (line %d)\n",  __LINE__ );
             return NULL;
         }
+        if( !(glyph = texture_glyph_new( )) )
+            return NULL;
         texture_atlas_set_region( self->atlas, region.x, region.y, 4, 4, data, 0 );
         glyph->charcode = (int32_t)(-1);
-        glyph->s0 = (region.x+2)/(float)width;
-        glyph->t0 = (region.y+2)/(float)height;
-        glyph->s1 = (region.x+3)/(float)width;
-        glyph->t1 = (region.y+3)/(float)height;
+        glyph->region = region;
+        glyph_set_texcoords( glyph, self->atlas );
         vector_push_back( self->glyphs, &glyph );
+        glyph_table_add( self, glyph );
         return glyph; //*(texture_glyph_t **) vector_back( self->glyphs );
     }
 
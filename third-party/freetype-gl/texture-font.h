@@ -207,6 +207,16 @@ typedef struct
      */
     float outline_thickness;
 
+    /**
+     * Region allocated for the glyph in the atlas, padding included
+     */
+    ivec4 region;
+
+    /**
+     * Atlas clock reading when the glyph was last looked up
+     */
+    size_t last_use;
+
 } texture_glyph_t;
 
 
@@ -221,6 +231,24 @@ typedef struct
      */
     vector_t * glyphs;
 
+    /**
+     * Glyphs for charcodes below 256, indexed directly by charcode. Each
+     * entry is the glyph that was last looked up for that charcode, so it
+     * still has to match the outline parameters of the request.
+     */
+    texture_glyph_t * latin1[256];
+
+    /**
+     * Open-addressing hash table over every glyph in the font, keyed by
+     * charcode and outline parameters. Lookups that miss the latin1 table
+     * land here instead of scanning the glyph vector.
+     */
+    struct {
+        texture_glyph_t ** slots;
+        size_t capacity;
+        size_t count;
+    } glyph_table;
+
     /**
      * Atlas structure to store glyphs data.
      */
@@ -269,6 +297,13 @@ typedef struct
      */
     float outline_thickness;
 
+    /**
+     * When non-zero, glyphs are stored as signed distance fields reaching
+     * this many pixels out from their outline rather than as coverage, so
+     * that they can be drawn at any scale. Only for atlases of depth 1.
+     */
+    int distance_field;
+
     /**
      * Whether to use our own lcd filter.
      */
@@ -383,6 +418,19 @@ typedef struct
                           int32_t charcode );
 
 
+/**
+ * Look up a glyph the font already has, without loading it.
+ *
+ * @param self     A valid texture font
+ * @param charcode Character codepoint to look up.
+ *
+ * @return The glyph, or 0 if it hasn't been loaded yet.
+ */
+  texture_glyph_t *
+  texture_font_find_glyph( texture_font_t * self,
+                           int32_t charcode );
+
+
 /**
  * Request the loading of several glyphs at once.
  *
@@ -396,6 +444,58 @@ typedef struct
   texture_font_load_glyphs( texture_font_t * self,
                             const int32_t * charcodes );
 
+/**
+ * A glyph rendered by FreeType but not yet placed in the atlas.
+ */
+typedef struct
+{
+    int32_t charcode;
+
+    /**
+     * Size of the bitmap in texels. Rows are width * atlas depth bytes.
+     */
+    size_t width, height;
+
+    int offset_x, offset_y;
+    float advance_x, advance_y;
+
+    unsigned char * buffer;
+} texture_glyph_bitmap_t;
+
+/**
+ * Render glyphs without touching the font's atlas or glyphs. The font is
+ * only read, and FreeType is set up afresh for the call, so this can run
+ * on another thread for as long as the font outlives it.
+ *
+ * @param self      a valid texture font
+ * @param charcodes character codepoints to be rendered, zero-terminated
+ *
+ * @return a vector of texture_glyph_bitmap_t, which stops short at the
+ *         first glyph that couldn't be rendered. NULL if out of memory.
+ */
+  vector_t *
+  texture_font_rasterize_glyphs( const texture_font_t * self,
+                                 const int32_t * charcodes );
+
+/**
+ * Place rendered glyphs in the font's atlas and upload it. Glyphs the
+ * font already has are skipped.
+ *
+ * @param self      a valid texture font
+ * @param bitmaps   from texture_font_rasterize_glyphs() on this font
+ *
+ * @return Number of glyphs added.
+ */
+  size_t
+  texture_font_add_glyphs( texture_font_t * self,
+                           const vector_t * bitmaps );
+
+/**
+ * Free the result of texture_font_rasterize_glyphs().
+ */
+  void
+  texture_glyph_bitmaps_delete( vector_t * bitmaps );
+
 /**
  * Get the kerning between two horizontal glyphs.
  *
@@ -42,6 +42,12 @@ static PROC WinGetProcAddress(const char *name)
 #define IntGetProcAddress(name) WinGetProcAddress(name)
 #endif
 
+#if defined(RTB_USE_EGL)
+#include <EGL/egl.h>
+
+#define IntGetProcAddress(name) eglGetProcAddress(name)
+#endif
+
 /* Linux, FreeBSD, other */
 #ifndef IntGetProcAddress
 	extern void ( * glXGetProcAddressARB (const GLubyte *procName)) (void);
@@ -49,8 +55,6 @@ static PROC WinGetProcAddress(const char *name)
 	#define IntGetProcAddress(name) (*glXGetProcAddressARB)((const GLubyte*)name)
 #endif
 
-/* TODO: Need to eventually use eglGetProcAddress */
-
 void (CODEGEN_FUNCPTR *_ptrc_glBlendFunc)(GLenum, GLenum) = NULL;
 void (CODEGEN_FUNCPTR *_ptrc_glClear)(GLbitfield) = NULL;
 void (CODEGEN_FUNCPTR *_ptrc_glClearColor)(GLfloat, GLfloat, GLfloat, GLfloat) = NULL;
@@ -31,7 +31,8 @@ from rutabaga_css.prop import RutabagaStyleProperty
 from rutabaga_css.parser import ParseError
 
 all = [
-    'RutabagaFloatProperty']
+    'RutabagaFloatProperty',
+    'RutabagaNumberProperty']
 
 class RutabagaFloatProperty(RutabagaStyleProperty):
     def __init__(self, stylesheet, name, tokens):
@@ -54,3 +55,17 @@ class RutabagaFloatProperty(RutabagaStyleProperty):
 
     def c_repr(self):
         return self.c_repr_tpl.format(val=self.value)
+
+
+# unitless, like flex-grow. compiles to the same thing as the above.
+class RutabagaNumberProperty(RutabagaFloatProperty):
+    def __init__(self, stylesheet, name, tokens):
+        self.name  = name
+        self.value = None
+
+        tok = tokens[0]
+
+        if tok.type in ('NUMBER', 'INTEGER'):
+            self.value = tok.value
+        else:
+            raise ParseError(tokens[0], 'expected number')
@@ -58,6 +58,12 @@ prop_mapping = {
 
     'min-width':  RutabagaFloatProperty,
     'min-height': RutabagaFloatProperty,
+    'max-width':  RutabagaFloatProperty,
+    'max-height': RutabagaFloatProperty,
+
+    'flex-grow':   RutabagaNumberProperty,
+    'flex-shrink': RutabagaNumberProperty,
+    'gap':         RutabagaFloatProperty,
 
     ####
     # unabashedly nonstandard props
@@ -66,6 +72,28 @@ prop_mapping = {
     '-rtb-knob-rotor': RutabagaTextureProperty,
 }
 
+# has to be kept in sync with rtb_style_key_t in rutabaga/style.h
+key_mapping = {
+    'color':            'RTB_STYLE_KEY_COLOR',
+    'background-color': 'RTB_STYLE_KEY_BACKGROUND_COLOR',
+    'background-image': 'RTB_STYLE_KEY_BACKGROUND_IMAGE',
+    'border-image':     'RTB_STYLE_KEY_BORDER_IMAGE',
+    'border-color':     'RTB_STYLE_KEY_BORDER_COLOR',
+
+    'min-width':        'RTB_STYLE_KEY_MIN_WIDTH',
+    'min-height':       'RTB_STYLE_KEY_MIN_HEIGHT',
+    'max-width':        'RTB_STYLE_KEY_MAX_WIDTH',
+    'max-height':       'RTB_STYLE_KEY_MAX_HEIGHT',
+
+    'flex-grow':        'RTB_STYLE_KEY_FLEX_GROW',
+    'flex-shrink':      'RTB_STYLE_KEY_FLEX_SHRINK',
+    'gap':              'RTB_STYLE_KEY_GAP',
+
+    'font':             'RTB_STYLE_KEY_FONT',
+
+    '-rtb-knob-rotor':  'RTB_STYLE_KEY_KNOB_ROTOR',
+}
+
 class RutabagaStyleState(object):
     def __init__(self, stylesheet):
         self.stylesheet = stylesheet
@@ -109,7 +137,8 @@ class RutabagaStyleState(object):
 
     c_prop_repr = '''\
 \t\t\t\t{{"{0}",
-{1}}}'''
+\t\t\t\t\t.key = {1},
+{2}}}'''
 
     def done_parsing(self):
         if self.font_descriptor['family']:
@@ -125,7 +154,8 @@ class RutabagaStyleState(object):
             state=state_mapping[state_name],
             properties=',\n\n'.join(
                 [self.c_prop_repr.format(
-                    prop_name, self.props[prop_name].c_repr())
+                    prop_name, key_mapping[prop_name],
+                    self.props[prop_name].c_repr())
                     for prop_name in self.props]
                 + ['\t\t\t\t{NULL}']))
 